@@ -77,6 +77,8 @@ namespace Components
 		Loader::Register(new Gametypes());
 		Loader::Register(new Materials());
 		Loader::Register(new Scheduler());
+		Loader::Register(new Persistence());
+		Loader::Register(new CryptoPool());
 		Loader::Register(new Threading());
 		Loader::Register(new CardTitles());
 		Loader::Register(new FileSystem());
@@ -105,9 +107,11 @@ namespace Components
 		Loader::Register(new Elevators());
 		Loader::Register(new ClientCommand());
 		Loader::Register(new ScriptExtension());
+		Loader::Register(new ScriptFileIO());
 		Loader::Register(new Branding());
 		Loader::Register(new RawMouse());
 		Loader::Register(new Bullet());
+		Loader::Register(new PacketCapture());
 
 		Loader::Pregame = false;
 	}
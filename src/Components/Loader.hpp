@@ -62,6 +62,8 @@ namespace Components
 }
 
 #include "Modules/Scheduler.hpp"
+#include "Modules/Persistence.hpp"
+#include "Modules/CryptoPool.hpp"
 #include "Modules/Auth.hpp"
 #include "Modules/Bans.hpp"
 #include "Modules/Bots.hpp"
@@ -83,6 +85,8 @@ namespace Components
 #include "Modules/ModList.hpp"
 #include "Modules/Monitor.hpp"
 #include "Modules/Network.hpp"
+#include "Modules/AddressMap.hpp"
+#include "Modules/PacketCapture.hpp"
 #include "Modules/Theatre.hpp"
 #include "Modules/QuickPatch.hpp"
 #include "Modules/Security.hpp"
@@ -136,6 +140,7 @@ namespace Components
 #include "Modules/ClientCommand.hpp"
 #include "Modules/Gamepad.hpp"
 #include "Modules/ScriptExtension.hpp"
+#include "Modules/ScriptFileIO.hpp"
 #include "Modules/Branding.hpp"
 #include "Modules/RawMouse.hpp"
 #include "Modules/Bullet.hpp"
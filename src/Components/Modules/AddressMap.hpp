@@ -0,0 +1,175 @@
+#pragma once
+
+namespace Components
+{
+	// Open-addressing hash map keyed by Network::Address.
+	// Probing only touches the packed 64-bit keys, the entries are stored in a parallel array.
+	// Erasing leaves a tombstone, so erasing while iterating is safe.
+	template <typename T>
+	class AddressMap
+	{
+	public:
+		using value_type = std::pair<Network::Address, T>;
+
+		class iterator
+		{
+		public:
+			iterator(AddressMap* _map, size_t _index) : map(_map), index(_index) { this->skip(); }
+
+			value_type& operator*() const { return this->map->entries[this->index]; }
+			value_type* operator->() const { return &this->map->entries[this->index]; }
+
+			iterator& operator++() { ++this->index; this->skip(); return *this; }
+
+			bool operator==(const iterator& obj) const { return this->index == obj.index; }
+			bool operator!=(const iterator& obj) const { return this->index != obj.index; }
+
+		private:
+			friend class AddressMap;
+
+			AddressMap* map;
+			size_t index;
+
+			void skip()
+			{
+				while (this->index < this->map->keys.size() && !AddressMap::IsUsed(this->map->keys[this->index])) ++this->index;
+			}
+		};
+
+		AddressMap() : count(0), tombstones(0) {}
+
+		iterator begin() { return iterator(this, 0); }
+		iterator end() { return iterator(this, this->keys.size()); }
+
+		size_t size() const { return this->count; }
+		bool empty() const { return this->count == 0; }
+
+		void clear()
+		{
+			this->keys.clear();
+			this->entries.clear();
+			this->count = 0;
+			this->tombstones = 0;
+		}
+
+		void reserve(size_t elements)
+		{
+			size_t capacity = 16;
+			while (capacity * 3 < elements * 4) capacity <<= 1;
+
+			if (capacity > this->keys.size()) this->rehash(capacity);
+		}
+
+		iterator find(const Network::Address& address)
+		{
+			const auto index = this->lookup(address.getKey());
+			return index == AddressMap::NotFound ? this->end() : iterator(this, index);
+		}
+
+		bool contains(const Network::Address& address)
+		{
+			return this->lookup(address.getKey()) != AddressMap::NotFound;
+		}
+
+		T& operator[](const Network::Address& address)
+		{
+			const auto key = address.getKey();
+
+			auto index = this->lookup(key);
+			if (index != AddressMap::NotFound) return this->entries[index].second;
+
+			// Keep the load factor, including tombstones, below 3/4
+			if ((this->count + this->tombstones + 1) * 4 > this->keys.size() * 3)
+			{
+				this->rehash(std::max<size_t>(16, (this->count + 1) * 4 > this->keys.size() ? this->keys.size() * 2 : this->keys.size()));
+			}
+
+			const auto mask = this->keys.size() - 1;
+			index = Network::Address::Hash(key) & mask;
+
+			while (AddressMap::IsUsed(this->keys[index])) index = (index + 1) & mask;
+
+			if (this->keys[index] == AddressMap::Deleted) --this->tombstones;
+
+			this->keys[index] = key;
+			this->entries[index].first = address;
+			++this->count;
+
+			return this->entries[index].second;
+		}
+
+		iterator erase(iterator entry)
+		{
+			this->remove(entry.index);
+			return ++entry;
+		}
+
+		bool erase(const Network::Address& address)
+		{
+			const auto index = this->lookup(address.getKey());
+			if (index == AddressMap::NotFound) return false;
+
+			this->remove(index);
+			return true;
+		}
+
+	private:
+		static constexpr uint64_t Empty = ~0ull;
+		static constexpr uint64_t Deleted = ~0ull - 1;
+		static constexpr size_t NotFound = ~static_cast<size_t>(0);
+
+		std::vector<uint64_t> keys;
+		std::vector<value_type> entries;
+		size_t count;
+		size_t tombstones;
+
+		static bool IsUsed(uint64_t key)
+		{
+			return key != AddressMap::Empty && key != AddressMap::Deleted;
+		}
+
+		size_t lookup(uint64_t key) const
+		{
+			if (this->keys.empty()) return AddressMap::NotFound;
+
+			const auto mask = this->keys.size() - 1;
+			for (auto index = Network::Address::Hash(key) & mask; this->keys[index] != AddressMap::Empty; index = (index + 1) & mask)
+			{
+				if (this->keys[index] == key) return index;
+			}
+
+			return AddressMap::NotFound;
+		}
+
+		void remove(size_t index)
+		{
+			this->keys[index] = AddressMap::Deleted;
+			this->entries[index] = value_type();
+
+			--this->count;
+			++this->tombstones;
+		}
+
+		void rehash(size_t capacity)
+		{
+			std::vector<uint64_t> oldKeys = std::move(this->keys);
+			std::vector<value_type> oldEntries = std::move(this->entries);
+
+			this->keys.assign(capacity, AddressMap::Empty);
+			this->entries = std::vector<value_type>(capacity);
+			this->tombstones = 0;
+
+			const auto mask = capacity - 1;
+			for (size_t i = 0; i < oldKeys.size(); ++i)
+			{
+				if (!AddressMap::IsUsed(oldKeys[i])) continue;
+
+				auto index = Network::Address::Hash(oldKeys[i]) & mask;
+				while (this->keys[index] != AddressMap::Empty) index = (index + 1) & mask;
+
+				this->keys[index] = oldKeys[i];
+				this->entries[index] = std::move(oldEntries[i]);
+			}
+		}
+	};
+}
@@ -14,6 +14,8 @@ namespace Components
 		0xf7e33c4081337fa3,
 		0x6f5597f103cc50e9
 	};
+
+	std::unordered_set<std::uint64_t> Auth::PendingConnects;
 	
 	void Auth::Frame()
 	{
@@ -156,7 +158,7 @@ namespace Components
 		else
 		{
 			// Validate proto data
-			if (connectData.signature().empty() || connectData.publickey().empty() || connectData.token().empty() || connectData.infostring().empty())
+			if (connectData.signature().empty() || connectData.publickey().empty() || connectData.token().empty() || connectData.token().size() > Utils::Cryptography::Token::Capacity || connectData.infostring().empty())
 			{
 				Network::Send(address, "error\nInvalid connect data!");
 				return;
@@ -213,32 +215,56 @@ namespace Components
 				return;
 			}
 
-			// Verify the signature
-			Utils::Cryptography::ECC::Key key;
-			key.set(connectData.publickey());
+			// Clients resend their connect packet while waiting, only verify it once
+			if (!Auth::PendingConnects.insert(address.getKey()).second) return;
 
-			if (!key.isValid() || !Utils::Cryptography::ECC::VerifyMessage(key, challenge, connectData.signature()))
+			// Verify the signature off the main thread, the client connects once it has been checked
+			const auto queued = CryptoPool::Verify(connectData.publickey(), challenge, connectData.signature(),
+				[address, infoString = connectData.infostring(), token = connectData.token(), publicKey = connectData.publickey(), xuid](bool valid)
 			{
-				Network::Send(address, "error\nChallenge signature was invalid!");
-				return;
-			}
-
-			// Verify the security level
-			auto ourLevel = Dvar::Var("sv_securityLevel").get<unsigned int>();
-			auto userLevel = Auth::GetZeroBits(connectData.token(), connectData.publickey());
+				Auth::FinishConnect(address, infoString, token, publicKey, xuid, valid);
+			});
 
-			if (userLevel < ourLevel)
+			if (!queued)
 			{
-				Network::Send(address, Utils::String::VA("error\nYour security level (%d) is lower than the server's security level (%d)", userLevel, ourLevel));
-				return;
+				Auth::PendingConnects.erase(address.getKey());
+				Network::Send(address, "error\nServer is busy, try again later.");
 			}
-
-			Logger::Print("Verified XUID %llX (%d) from %s\n", xuid, userLevel, address.getCString());
-			Game::SV_DirectConnect(*address.get());
 		}
 #endif
 	}
 
+	void Auth::FinishConnect(Network::Address address, const std::string& infoString, const std::string& token, const std::string& publicKey, uint64_t xuid, bool valid)
+	{
+		Auth::PendingConnects.erase(address.getKey());
+
+		// The server might have shut down in the meantime
+		if (!Dvar::Var("sv_running").get<bool>()) return;
+
+		if (!valid)
+		{
+			Network::Send(address, "error\nChallenge signature was invalid!");
+			return;
+		}
+
+		// Verify the security level
+		auto ourLevel = Dvar::Var("sv_securityLevel").get<unsigned int>();
+		auto userLevel = Auth::GetZeroBits(token, publicKey);
+
+		if (userLevel < ourLevel)
+		{
+			Network::Send(address, Utils::String::VA("error\nYour security level (%d) is lower than the server's security level (%d)", userLevel, ourLevel));
+			return;
+		}
+
+		Logger::Print("Verified XUID %llX (%d) from %s\n", xuid, userLevel, address.getCString());
+
+		// SV_DirectConnect reads the connect string from the command arguments
+		Game::SV_Cmd_TokenizeString(infoString.data());
+		Game::SV_DirectConnect(*address.get());
+		Game::SV_Cmd_EndTokenizedString();
+	}
+
 	__declspec(naked) void Auth::DirectConnectStub()
 	{
 		__asm
@@ -356,35 +382,123 @@ namespace Components
 
 	uint32_t Auth::GetZeroBits(Utils::Cryptography::Token token, const std::string& publicKey)
 	{
-		std::string message = publicKey + token.toString();
+		std::string message = publicKey;
+		message.append(reinterpret_cast<const char*>(token.data()), token.size());
+
 		std::string hash = Utils::Cryptography::SHA512::Compute(message, false);
+		return Utils::Cryptography::SHA512::CountLeadingZeroBits(reinterpret_cast<const uint8_t*>(hash.data()), hash.size());
+	}
 
-		uint32_t bits = 0;
+	void Auth::SearchTokens(TokenSearch* search, Utils::Cryptography::Token base, const std::string& publicKey, uint32_t zeroBits, bool* cancel, uint64_t* count)
+	{
+		// The public key is the same for every candidate, only hash it once
+		const auto midstate = Utils::Cryptography::SHA512::Prefix(reinterpret_cast<const uint8_t*>(publicKey.data()), publicKey.size());
 
-		for (unsigned int i = 0; i < hash.size(); ++i)
+		while (!cancel || !*cancel)
 		{
-			if (hash[i] == '\0')
+			// Chunks are handed out in order, so everything below a solution gets searched
+			const auto chunk = search->nextChunk++;
+			const auto start = 1 + chunk * AUTH_TOKEN_CHUNK;
+
 			{
-				bits += 8;
-				continue;
+				std::lock_guard<std::mutex> _(search->mutex);
+				if (start > search->found) break;
 			}
 
-			uint8_t value = static_cast<uint8_t>(hash[i]);
-			for (int j = 7; j >= 0; --j)
+			auto candidate = base;
+			candidate += start;
+
+			uint32_t bestLevel = 0;
+			uint64_t bestOffset = 0;
+			uint64_t found = ~0ull;
+			uint64_t hashes = 0;
+			bool complete = true;
+
+			for (uint64_t offset = start; offset < start + AUTH_TOKEN_CHUNK && found == ~0ull; offset += Utils::Cryptography::SHA512::MaxLanes)
 			{
-				if ((value >> j) & 1)
+				// Allow canceling that shit
+				if (cancel && *cancel)
+				{
+					complete = false;
+					break;
+				}
+
+				Utils::Cryptography::Token candidates[Utils::Cryptography::SHA512::MaxLanes];
+				const uint8_t* suffixes[Utils::Cryptography::SHA512::MaxLanes];
+				uint8_t hashBuffer[Utils::Cryptography::SHA512::MaxLanes][64];
+				uint8_t* hashPointers[Utils::Cryptography::SHA512::MaxLanes];
+
+				const auto lanes = static_cast<size_t>(std::min<uint64_t>(Utils::Cryptography::SHA512::MaxLanes, start + AUTH_TOKEN_CHUNK - offset));
+				bool sameLength = true;
+
+				for (size_t i = 0; i < lanes; ++i, ++candidate)
 				{
-					return bits;
+					candidates[i] = candidate;
+					suffixes[i] = candidates[i].data();
+					hashPointers[i] = hashBuffer[i];
+					sameLength &= candidates[i].size() == candidates[0].size();
 				}
 
-				++bits;
+				// A token only grows when it overflows, that batch is hashed one by one
+				if (sameLength)
+				{
+					Utils::Cryptography::SHA512::FinishMulti(midstate, suffixes, candidates[0].size(), hashPointers, lanes);
+				}
+				else
+				{
+					for (size_t i = 0; i < lanes; ++i)
+					{
+						Utils::Cryptography::SHA512::Finish(midstate, suffixes[i], candidates[i].size(), hashPointers[i]);
+					}
+				}
+
+				hashes += lanes;
+
+				for (size_t i = 0; i < lanes; ++i)
+				{
+					const auto level = Utils::Cryptography::SHA512::CountLeadingZeroBits(hashBuffer[i]);
+
+					if (level >= bestLevel)
+					{
+						bestLevel = level;
+						bestOffset = offset + i;
+					}
+
+					// The rest of the chunk can't contain a lower solution
+					if (level >= zeroBits)
+					{
+						found = offset + i;
+						break;
+					}
+				}
 			}
-		}
 
-		return bits;
+			std::lock_guard<std::mutex> _(search->mutex);
+
+			if (count) *count += hashes;
+
+			if (bestLevel > search->bestLevel || (bestLevel == search->bestLevel && bestOffset > search->bestOffset))
+			{
+				search->bestLevel = bestLevel;
+				search->bestOffset = bestOffset;
+			}
+
+			search->found = std::min(search->found, found);
+
+			if (complete)
+			{
+				search->finishedChunks.insert(chunk);
+
+				while (!search->finishedChunks.empty() && *search->finishedChunks.begin() == search->finishedPrefix)
+				{
+					search->finishedChunks.erase(search->finishedChunks.begin());
+					++search->finishedPrefix;
+				}
+			}
+		}
 	}
 
-	void Auth::IncrementToken(Utils::Cryptography::Token& token, Utils::Cryptography::Token& computeToken, const std::string& publicKey, uint32_t zeroBits, bool* cancel, uint64_t* count)
+	void Auth::IncrementToken(Utils::Cryptography::Token& token, Utils::Cryptography::Token& computeToken, const std::string& publicKey, uint32_t zeroBits, bool* cancel, uint64_t* count, unsigned int threads)
 	{
 		if (zeroBits > 512) return; // Not possible, due to SHA512
 
@@ -395,27 +509,50 @@ namespace Components
 
 		// Check if we already have the desired security level
 		uint32_t lastLevel = Auth::GetZeroBits(token, publicKey);
-		uint32_t level = lastLevel;
-		if (level >= zeroBits) return;
+		if (lastLevel >= zeroBits) return;
+
+		if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+
+		TokenSearch search;
+		search.nextChunk = 0;
+		search.found = ~0ull;
+		search.bestOffset = 0;
+		search.bestLevel = 0;
+		search.finishedPrefix = 0;
 
-		do
+		// Workers search disjoint ranges above the compute token
+		std::vector<std::thread> workers;
+		for (unsigned int i = 1; i < threads; ++i)
 		{
-			++computeToken;
-			if (count) ++(*count);
-			level = Auth::GetZeroBits(computeToken, publicKey);
+			workers.emplace_back(Auth::SearchTokens, &search, computeToken, publicKey, zeroBits, cancel, count);
+		}
 
-			// Store level if higher than the last one
-			if (level >= lastLevel)
-			{
-				token = computeToken;
-				lastLevel = level;
-			}
+		Auth::SearchTokens(&search, computeToken, publicKey, zeroBits, cancel, count);
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
 
-			// Allow canceling that shit
-			if (cancel && *cancel) return;
-		} while (level < zeroBits);
+		const auto base = computeToken;
 
-		token = computeToken;
+		// The lowest solution, this is the token a sequential search would have stopped at
+		if (search.found != ~0ull)
+		{
+			token = base;
+			token += search.found;
+			computeToken = token;
+			return;
+		}
+
+		// Cancelled, continue after the searched prefix next time and keep the best token so far
+		computeToken += search.finishedPrefix * AUTH_TOKEN_CHUNK;
+
+		if (search.bestOffset && search.bestLevel >= lastLevel)
+		{
+			token = base;
+			token += search.bestOffset;
+		}
 	}
 
 	Auth::Auth()
@@ -554,6 +691,130 @@ namespace Components
 			success = false;
 		}
 
+		printf("Operator <  (big-endian) : ");
+		if (Utils::Cryptography::Token("\x00\x01"s) < Utils::Cryptography::Token("\x01\x00"s) && !(Utils::Cryptography::Token("\x01\x00"s) < Utils::Cryptography::Token("\x00\x01"s))) printf("Success\n");
+		else
+		{
+			printf("Error\n");
+			success = false;
+		}
+
+		printf("Testing streaming hashes...");
+
+		{
+			const auto data = Utils::Cryptography::Rand::GenerateChallenge() + std::string(300, 'x') + Utils::Cryptography::Rand::GenerateChallenge();
+
+			Utils::Cryptography::SHA256 sha256;
+			Utils::Cryptography::SHA512 sha512;
+
+			// Uneven chunks, so updates cross the block boundaries
+			for (size_t offset = 0; offset < data.size(); offset += 37)
+			{
+				sha256.update(data.substr(offset, 37));
+				sha512.update(data.substr(offset, 37));
+			}
+
+			if (sha256.finalize(true) == Utils::Cryptography::SHA256::Compute(data, true) && sha512.finalize() == Utils::Cryptography::SHA512::Compute(data)) printf("Success\n");
+			else
+			{
+				printf("Error\n");
+				success = false;
+			}
+		}
+
+		printf("Testing SHA512 midstate kernel (%s)...", Utils::Cryptography::SHA512::HasAVX2() ? "AVX2" : "SSE2");
+
+		bool kernelSuccess = true;
+		for (int i = 0; i < 256 && kernelSuccess; ++i)
+		{
+			// Covers prefixes spanning several blocks and suffixes needing one or two final blocks
+			const auto prefix = Utils::Cryptography::Rand::GenerateChallenge().substr(0, i % 32) + std::string(i, static_cast<char>(i));
+			const auto suffixLength = static_cast<size_t>(i % 48);
+			const auto midstate = Utils::Cryptography::SHA512::Prefix(reinterpret_cast<const uint8_t*>(prefix.data()), prefix.size());
+
+			std::string suffixes[Utils::Cryptography::SHA512::MaxLanes];
+			const uint8_t* suffixPointers[Utils::Cryptography::SHA512::MaxLanes];
+			uint8_t hashes[Utils::Cryptography::SHA512::MaxLanes][64];
+			uint8_t* hashPointers[Utils::Cryptography::SHA512::MaxLanes];
+
+			const auto lanes = 1 + i % Utils::Cryptography::SHA512::MaxLanes;
+			for (size_t j = 0; j < lanes; ++j)
+			{
+				suffixes[j] = Utils::Cryptography::Rand::GenerateChallenge();
+				suffixes[j].resize(suffixLength, static_cast<char>(j));
+				suffixPointers[j] = reinterpret_cast<const uint8_t*>(suffixes[j].data());
+				hashPointers[j] = hashes[j];
+			}
+
+			Utils::Cryptography::SHA512::FinishMulti(midstate, suffixPointers, suffixLength, hashPointers, lanes);
+
+			for (size_t j = 0; j < lanes; ++j)
+			{
+				const auto expected = Utils::Cryptography::SHA512::Compute(prefix + suffixes[j]);
+
+				uint8_t single[64];
+				Utils::Cryptography::SHA512::Finish(midstate, suffixPointers[j], suffixLength, single);
+
+				if (std::memcmp(expected.data(), hashes[j], 64) || std::memcmp(expected.data(), single, 64))
+				{
+					kernelSuccess = false;
+					break;
+				}
+			}
+		}
+
+		const uint8_t zeroBitsTest[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0xFF };
+		if (Utils::Cryptography::SHA512::CountLeadingZeroBits(zeroBitsTest, sizeof(zeroBitsTest)) != 43 || Utils::Cryptography::SHA512::CountLeadingZeroBits(zeroBitsTest, 5) != 40)
+		{
+			kernelSuccess = false;
+		}
+
+		if (kernelSuccess) printf("Success\n");
+		else
+		{
+			printf("Error\n");
+			success = false;
+		}
+
+		printf("Testing parallel token search...");
+
+		const auto publicKey = Utils::Cryptography::ECC::GenerateKey(512).getPublicKey();
+
+		Utils::Cryptography::Token sequentialToken, sequentialCompute;
+		Utils::Cryptography::Token parallelToken, parallelCompute;
+		Auth::IncrementToken(sequentialToken, sequentialCompute, publicKey, 12, nullptr, nullptr, 1);
+		Auth::IncrementToken(parallelToken, parallelCompute, publicKey, 12, nullptr, nullptr);
+
+		if (sequentialToken == parallelToken && Auth::GetZeroBits(parallelToken, publicKey) >= 12) printf("Success\n");
+		else
+		{
+			printf("Error\n");
+			success = false;
+		}
+
+		// Benchmark, each run searches for an unreachable level and is cancelled after a second
+		const auto cores = std::max(1u, std::thread::hardware_concurrency());
+		for (auto threads : { 1u, cores })
+		{
+			bool cancel = false;
+			uint64_t hashes = 0;
+			Utils::Cryptography::Token token, computeToken;
+
+			std::thread timer([&cancel]()
+			{
+				std::this_thread::sleep_for(1s);
+				cancel = true;
+			});
+
+			const auto start = std::chrono::high_resolution_clock::now();
+			Auth::IncrementToken(token, computeToken, publicKey, 512, &cancel, &hashes, threads);
+			const auto duration = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			timer.join();
+
+			printf("Token search with %u thread(s): %.0f hashes/s, %.0f hashes/s per core\n", threads, hashes / duration, hashes / duration / threads);
+		}
+
 		return success;
 	}
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+// Tokens handed to a worker at once by the parallel token search
+#define AUTH_TOKEN_CHUNK 1024
+
 namespace Components
 {
 	class Auth : public Component
@@ -22,7 +25,7 @@ namespace Components
 		static void IncreaseSecurityLevel(uint32_t level, const std::string& command = "");
 
 		static uint32_t GetZeroBits(Utils::Cryptography::Token token, const std::string& publicKey);
-		static void IncrementToken(Utils::Cryptography::Token& token, Utils::Cryptography::Token& computeToken, const std::string& publicKey, uint32_t zeroBits, bool* cancel = nullptr, uint64_t* count = nullptr);
+		static void IncrementToken(Utils::Cryptography::Token& token, Utils::Cryptography::Token& computeToken, const std::string& publicKey, uint32_t zeroBits, bool* cancel = nullptr, uint64_t* count = nullptr, unsigned int threads = 0);
 
 	private:
 
@@ -38,17 +41,39 @@ namespace Components
 			uint64_t hashes;
 		};
 
+		// Shared state of the workers of one IncrementToken call, offsets are relative to the compute token
+		class TokenSearch
+		{
+		public:
+			std::mutex mutex;
+			std::atomic<uint64_t> nextChunk;
+
+			uint64_t found; // Lowest offset of a valid token
+			uint64_t bestOffset;
+			uint32_t bestLevel;
+
+			// Chunks below finishedPrefix have all been searched
+			uint64_t finishedPrefix;
+			std::set<uint64_t> finishedChunks;
+		};
+
 		static TokenIncrementing TokenContainer;
 
 		static Utils::Cryptography::Token GuidToken;
 		static Utils::Cryptography::Token ComputeToken;
 		static Utils::Cryptography::ECC::Key GuidKey;
 		static std::vector<std::uint64_t> BannedUids;
+
+		// Addresses whose connect signature is being verified, see Network::Address::getKey
+		static std::unordered_set<std::uint64_t> PendingConnects;
 		
 		static void SendConnectDataStub(Game::netsrc_t sock, Game::netadr_t adr, const char *format, int len);
 		static void ParseConnectData(Game::msg_t* msg, Game::netadr_t* addr);
+		static void FinishConnect(Network::Address address, const std::string& infoString, const std::string& token, const std::string& publicKey, uint64_t xuid, bool valid);
 		static void DirectConnectStub();
 
+		static void SearchTokens(TokenSearch* search, Utils::Cryptography::Token base, const std::string& publicKey, uint32_t zeroBits, bool* cancel, uint64_t* count);
+
 		static void Frame();
 	};
 }
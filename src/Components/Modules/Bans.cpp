@@ -3,167 +3,428 @@
 namespace Components
 {
 	std::recursive_mutex Bans::AccessMutex;
+	bool Bans::Loaded = false;
 
-	bool Bans::IsBanned(Bans::Entry entry)
+	std::unordered_set<uint64_t> Bans::IdSet;
+	Bans::IPTrie Bans::IPRanges;
+
+	unsigned int Bans::Generation = 0;
+	unsigned int Bans::StaleGeneration = 0;
+	unsigned int Bans::JournalRecords = 0;
+	unsigned long long Bans::LastModified = 0;
+
+	std::atomic<size_t> Bans::WrittenHash;
+	std::atomic<unsigned int> Bans::WrittenGeneration;
+
+	void Bans::IPTrie::clear()
 	{
-		std::lock_guard<std::recursive_mutex> _(Bans::AccessMutex);
+		this->nodes.clear();
+		this->nodes.push_back({ { 0, 0 }, false });
+	}
 
-		Bans::BanList list;
-		Bans::LoadBans(&list);
+	void Bans::IPTrie::insert(uint32_t ip, uint8_t bits)
+	{
+		uint32_t index = 0;
 
-		if (entry.first.bits)
+		for (uint8_t i = 0; i < bits; ++i)
 		{
-			for (auto& idEntry : list.idList)
+			const auto bit = (ip >> (31 - i)) & 1;
+
+			if (!this->nodes[index].children[bit])
 			{
-				if (idEntry.bits == entry.first.bits)
-				{
-					return true;
-				}
+				this->nodes[index].children[bit] = static_cast<uint32_t>(this->nodes.size());
+				this->nodes.push_back({ { 0, 0 }, false });
 			}
+
+			index = this->nodes[index].children[bit];
 		}
 
-		if (entry.second.full)
+		this->nodes[index].terminal = true;
+	}
+
+	bool Bans::IPTrie::erase(uint32_t ip, uint8_t bits)
+	{
+		uint32_t index = 0;
+
+		for (uint8_t i = 0; i < bits; ++i)
 		{
-			for (auto& ipEntry : list.ipList)
-			{
-				if (ipEntry.full == entry.second.full)
-				{
-					return true;
-				}
-			}
+			index = this->nodes[index].children[(ip >> (31 - i)) & 1];
+			if (!index) return false;
 		}
 
-		return false;
+		// Unused nodes stay until the next reload, lookups just pass through them
+		const auto terminal = this->nodes[index].terminal;
+		this->nodes[index].terminal = false;
+		return terminal;
 	}
 
-	void Bans::InsertBan(Bans::Entry entry)
+	bool Bans::IPTrie::contains(uint32_t ip) const
 	{
-		std::lock_guard<std::recursive_mutex> _(Bans::AccessMutex);
+		uint32_t index = 0;
+
+		for (uint8_t i = 0; ; ++i)
+		{
+			if (this->nodes[index].terminal) return true;
+			if (i == 32) return false;
+
+			index = this->nodes[index].children[(ip >> (31 - i)) & 1];
+			if (!index) return false;
+		}
+	}
+
+	std::vector<std::pair<uint32_t, uint8_t>> Bans::IPTrie::ranges() const
+	{
+		std::vector<std::pair<uint32_t, uint8_t>> result;
 
-		Bans::BanList list;
-		Bans::LoadBans(&list);
+		// Node index, prefix and prefix length
+		std::vector<std::tuple<uint32_t, uint32_t, uint8_t>> stack;
+		stack.emplace_back(0, 0, static_cast<uint8_t>(0));
 
-		if (entry.first.bits)
+		while (!stack.empty())
 		{
-			bool found = false;
-			for (auto& idEntry : list.idList)
+			const auto [index, prefix, bits] = stack.back();
+			stack.pop_back();
+
+			auto& node = this->nodes[index];
+			if (node.terminal) result.emplace_back(prefix, bits);
+
+			for (uint32_t bit = 0; bit < 2 && bits < 32; ++bit)
 			{
-				if (idEntry.bits == entry.first.bits)
+				if (node.children[bit])
 				{
-					found = true;
-					break;
+					stack.emplace_back(node.children[bit], prefix | (bit << (31 - bits)), static_cast<uint8_t>(bits + 1));
 				}
 			}
+		}
 
-			if (!found)
-			{
-				list.idList.push_back(entry.first);
-			}
+		return result;
+	}
+
+	std::string Bans::GetPath(const std::string& file)
+	{
+		char path[MAX_PATH] = { 0 };
+		Game::FS_BuildPathToFile(Dvar::Var("fs_basepath").get<const char*>(), reinterpret_cast<char*>(0x63D0BB8), file.data(), reinterpret_cast<char**>(&path));
+		return path;
+	}
+
+	std::string Bans::GetJournalPath(unsigned int generation)
+	{
+		return Bans::GetPath(Utils::String::VA("bans.%u.journal", generation));
+	}
+
+	std::vector<unsigned int> Bans::FindJournals()
+	{
+		std::vector<unsigned int> generations;
+
+		std::error_code error;
+		const auto directory = std::filesystem::path(Bans::GetPath("bans.json")).parent_path();
+
+		for (auto& file : std::filesystem::directory_iterator(directory, error))
+		{
+			const auto name = file.path().filename().string();
+			if (!Utils::String::StartsWith(name, "bans.") || !Utils::String::EndsWith(name, ".journal")) continue;
+
+			const auto number = name.substr(5, name.size() - 5 - 8);
+			if (number.empty() || number.find_first_not_of("0123456789") != std::string::npos) continue;
+
+			generations.push_back(static_cast<unsigned int>(std::strtoul(number.data(), nullptr, 10)));
 		}
 
-		if (entry.second.full)
+		std::sort(generations.begin(), generations.end());
+		return generations;
+	}
+
+	unsigned long long Bans::GetModifiedTime(const std::string& file)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesExA(file.data(), GetFileExInfoStandard, &data)) return 0;
+
+		return (static_cast<unsigned long long>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+	}
+
+	uint32_t Bans::GetAddress(Game::netIP_t ip)
+	{
+		return static_cast<uint32_t>(ip.bytes[0] & 0xFF) << 24 | static_cast<uint32_t>(ip.bytes[1] & 0xFF) << 16 | static_cast<uint32_t>(ip.bytes[2] & 0xFF) << 8 | (ip.bytes[3] & 0xFF);
+	}
+
+	bool Bans::ParseRange(const std::string& range, uint32_t* ip, uint8_t* bits)
+	{
+		const auto separator = range.find('/');
+
+		int prefix = 32;
+		if (separator != std::string::npos)
 		{
-			bool found = false;
-			for (auto& ipEntry : list.ipList)
-			{
-				if (ipEntry.full == entry.second.full)
-				{
-					found = true;
-					break;
-				}
-			}
+			prefix = atoi(range.data() + separator + 1);
+			if (prefix < 0 || prefix > 32) return false;
+		}
 
-			if (!found)
-			{
-				list.ipList.push_back(entry.second);
-			}
+		Network::Address address(range.substr(0, separator));
+		if (!address.isValid()) return false;
+
+		// Drop the host bits, so equal ranges share a trie node
+		*bits = static_cast<uint8_t>(prefix);
+		*ip = prefix ? Bans::GetAddress(address.getIP()) & (0xFFFFFFFFu << (32 - prefix)) : 0;
+		return true;
+	}
+
+	std::string Bans::FormatRange(uint32_t ip, uint8_t bits)
+	{
+		std::string range = Utils::String::VA("%u.%u.%u.%u", (ip >> 24) & 0xFF, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF);
+
+		// Single addresses keep the old format
+		if (bits != 32) range.append(Utils::String::VA("/%u", bits));
+		return range;
+	}
+
+	bool Bans::Apply(const std::string& record)
+	{
+		// Records are '+' or '-', the type and the value, e.g. "+ip 10.0.0.0/8"
+		if (record.size() < 5 || (record[0] != '+' && record[0] != '-') || record[3] != ' ') return false;
+
+		const auto insert = record[0] == '+';
+		const auto type = record.substr(1, 2);
+		const auto value = record.substr(4);
+
+		if (type == "id")
+		{
+			const auto id = strtoull(value.data(), nullptr, 16);
+			if (!id) return false;
+
+			if (insert) Bans::IdSet.insert(id);
+			else Bans::IdSet.erase(id);
+
+			return true;
 		}
 
-		Bans::SaveBans(&list);
+		if (type == "ip")
+		{
+			uint32_t ip;
+			uint8_t bits;
+			if (!Bans::ParseRange(value, &ip, &bits)) return false;
+
+			if (insert) Bans::IPRanges.insert(ip, bits);
+			else Bans::IPRanges.erase(ip, bits);
+
+			return true;
+		}
+
+		return false;
 	}
 
-	void Bans::SaveBans(BanList* list)
+	void Bans::Journal(const std::string& record)
+	{
+		Bans::Apply(record);
+		Persistence::Append(Bans::GetJournalPath(Bans::Generation), record + "\n");
+
+		if (++Bans::JournalRecords >= BANS_COMPACT_THRESHOLD)
+		{
+			Bans::Compact();
+		}
+	}
+
+	bool Bans::IsBanned(Bans::Entry entry)
 	{
 		std::lock_guard<std::recursive_mutex> _(Bans::AccessMutex);
+		if (!Bans::Loaded) Bans::LoadBans();
+
+		if (entry.first.bits && Bans::IdSet.find(entry.first.bits) != Bans::IdSet.end())
+		{
+			return true;
+		}
+
+		if (entry.second.full && Bans::IPRanges.contains(Bans::GetAddress(entry.second)))
+		{
+			return true;
+		}
+
+		return false;
+	}
+
+	void Bans::InsertBan(Bans::Entry entry)
+	{
+		std::lock_guard<std::recursive_mutex> _(Bans::AccessMutex);
+		if (!Bans::Loaded) Bans::LoadBans();
+
+		if (entry.first.bits && Bans::IdSet.find(entry.first.bits) == Bans::IdSet.end())
+		{
+			Bans::Journal(Utils::String::VA("+id %llX", entry.first.bits));
+		}
+
+		if (entry.second.full && !Bans::IPRanges.contains(Bans::GetAddress(entry.second)))
+		{
+			Bans::Journal("+ip " + Bans::FormatRange(Bans::GetAddress(entry.second), 32));
+		}
+	}
+
+	void Bans::Compact()
+	{
+		std::lock_guard<std::recursive_mutex> _(Bans::AccessMutex);
+
+		std::vector<uint64_t> ids(Bans::IdSet.begin(), Bans::IdSet.end());
+		std::sort(ids.begin(), ids.end());
 
 		std::vector<std::string> idVector;
 		std::vector<std::string> ipVector;
 
-		for (auto& idEntry : list->idList)
+		for (auto id : ids)
 		{
-			idVector.push_back(Utils::String::VA("%llX", idEntry.bits));
+			idVector.push_back(Utils::String::VA("%llX", id));
 		}
 
-		for (auto& ipEntry : list->ipList)
+		for (auto& range : Bans::IPRanges.ranges())
 		{
-			ipVector.push_back(Utils::String::VA("%u.%u.%u.%u",
-				ipEntry.bytes[0] & 0xFF,
-				ipEntry.bytes[1] & 0xFF,
-				ipEntry.bytes[2] & 0xFF,
-				ipEntry.bytes[3] & 0xFF));
+			ipVector.push_back(Bans::FormatRange(range.first, range.second));
 		}
 
-		json11::Json bans = json11::Json::object
+		// New records go to the next journal, the current one is part of the snapshot
+		const auto generation = ++Bans::Generation;
+		Bans::JournalRecords = 0;
+
+		// Resolved on the main thread, the worker must not touch the game's filesystem
+		Persistence::Store(Bans::GetPath("bans.json"), [ipVector, idVector, generation]()
 		{
-			{ "ip", ipVector },
-			{ "id", idVector },
-		};
+			json11::Json bans = json11::Json::object
+			{
+				{ "ip", ipVector },
+				{ "id", idVector },
+				{ "generation", static_cast<int>(generation) },
+			};
 
-		FileSystem::FileWriter ban("bans.json");
-		ban.write(bans.dump());
+			auto data = bans.dump();
+
+			Bans::WrittenHash = std::hash<std::string>()(data);
+			Bans::WrittenGeneration = generation;
+
+			return data;
+		});
 	}
 
-	void Bans::LoadBans(Bans::BanList* list)
+	void Bans::LoadBans()
 	{
 		std::lock_guard<std::recursive_mutex> _(Bans::AccessMutex);
 
-		FileSystem::File bans("bans.json");
+		Bans::Loaded = true;
+		Bans::IdSet.clear();
+		Bans::IPRanges.clear();
+		Bans::Generation = 0;
+		Bans::JournalRecords = 0;
 
-		if (bans.exists())
+		const auto path = Bans::GetPath("bans.json");
+		Bans::LastModified = Bans::GetModifiedTime(path);
+
+		std::string data;
+		if (Utils::IO::ReadFile(path, &data))
 		{
 			std::string error;
-			json11::Json banData = json11::Json::parse(bans.getBuffer(), error);
+			json11::Json banData = json11::Json::parse(data, error);
 
 			if (!error.empty())
 			{
 				Logger::Error("Failed to parse bans (bans.json): %s", error.data());
 			}
 
-			if (!list) return;
-
 			if (banData.is_object())
 			{
 				auto idList = banData["id"];
 				auto ipList = banData["ip"];
 
+				if (banData["generation"].is_number())
+				{
+					Bans::Generation = static_cast<unsigned int>(banData["generation"].int_value());
+				}
+
 				if (idList.is_array())
 				{
-					for (auto &idEntry : idList.array_items())
+					for (auto& idEntry : idList.array_items())
 					{
 						if (idEntry.is_string())
 						{
-							SteamID id;
-							id.bits = strtoull(idEntry.string_value().data(), nullptr, 16);
-
-							list->idList.push_back(id);
+							Bans::Apply("+id " + idEntry.string_value());
 						}
 					}
 				}
 
 				if (ipList.is_array())
 				{
-					for (auto &ipEntry : ipList.array_items())
+					for (auto& ipEntry : ipList.array_items())
 					{
 						if (ipEntry.is_string())
 						{
-							Network::Address addr(ipEntry.string_value());
-
-							list->ipList.push_back(addr.getIP());
+							Bans::Apply("+ip " + ipEntry.string_value());
 						}
 					}
 				}
 			}
 		}
+
+		// Journals older than the snapshot are already part of it. An edited snapshot may have lost its generation or carry an older one,
+		// the journals written since our last snapshot are still newer than it then, and stray ones from earlier sessions are found on disk
+		const auto snapshotGeneration = std::max(Bans::Generation, Bans::StaleGeneration);
+		Bans::Generation = snapshotGeneration;
+
+		for (auto generation : Bans::FindJournals())
+		{
+			if (generation < snapshotGeneration)
+			{
+				Utils::IO::RemoveFile(Bans::GetJournalPath(generation));
+				continue;
+			}
+
+			// Replay everything that happened after the snapshot, there may be several journals if compacting was interrupted
+			std::string journal;
+			if (!Utils::IO::ReadFile(Bans::GetJournalPath(generation), &journal)) continue;
+
+			Bans::Generation = generation;
+
+			for (auto& record : Utils::String::Split(journal, '\n'))
+			{
+				if (Bans::Apply(Utils::String::Trim(record))) ++Bans::JournalRecords;
+			}
+		}
+
+		Bans::StaleGeneration = snapshotGeneration;
+
+		if (Bans::Generation != snapshotGeneration || Bans::JournalRecords >= BANS_COMPACT_THRESHOLD)
+		{
+			Bans::Compact();
+		}
+	}
+
+	void Bans::CheckModified()
+	{
+		static Utils::Time::Interval interval;
+		if (!interval.elapsed(5s)) return;
+		interval.update();
+
+		std::lock_guard<std::recursive_mutex> _(Bans::AccessMutex);
+		if (!Bans::Loaded) return;
+
+		const auto path = Bans::GetPath("bans.json");
+		const auto modified = Bans::GetModifiedTime(path);
+		if (modified == Bans::LastModified) return;
+
+		Bans::LastModified = modified;
+
+		std::string data;
+		Utils::IO::ReadFile(path, &data);
+
+		if (!data.empty() && std::hash<std::string>()(data) == Bans::WrittenHash)
+		{
+			// Our snapshot is on disk now, the journals it includes aren't needed anymore
+			const unsigned int written = Bans::WrittenGeneration;
+			for (; Bans::StaleGeneration < written; ++Bans::StaleGeneration)
+			{
+				Utils::IO::RemoveFile(Bans::GetJournalPath(Bans::StaleGeneration));
+			}
+
+			return;
+		}
+
+		// Changed by someone else, the journals have to be on disk before replaying them
+		Persistence::Flush();
+		Bans::LoadBans();
+
+		Logger::Print("Reloaded bans.json, %u GUIDs and %u IP ranges banned\n", Bans::IdSet.size(), Bans::IPRanges.ranges().size());
 	}
 
 	void Bans::BanClientNum(int num, const std::string& reason)
@@ -193,41 +454,55 @@ namespace Components
 	void Bans::UnbanClient(SteamID id)
 	{
 		std::lock_guard<std::recursive_mutex> _(Bans::AccessMutex);
+		if (!Bans::Loaded) Bans::LoadBans();
 
-		Bans::BanList list;
-		Bans::LoadBans(&list);
-
-		auto entry = std::find_if(list.idList.begin(), list.idList.end(), [&id](SteamID& entry)
+		if (Bans::IdSet.find(id.bits) != Bans::IdSet.end())
 		{
-			return id.bits == entry.bits;
-		});
-
-		if (entry != list.idList.end())
-		{
-			list.idList.erase(entry);
+			Bans::Journal(Utils::String::VA("-id %llX", id.bits));
 		}
+	}
 
-		Bans::SaveBans(&list);
+	void Bans::UnbanClient(Game::netIP_t ip, uint8_t bits)
+	{
+		bits = std::min<uint8_t>(bits, 32);
+		Bans::UnbanRange(bits ? Bans::GetAddress(ip) & (0xFFFFFFFFu << (32 - bits)) : 0, bits);
 	}
 
-	void Bans::UnbanClient(Game::netIP_t ip)
+	void Bans::UnbanRange(uint32_t ip, uint8_t bits)
 	{
 		std::lock_guard<std::recursive_mutex> _(Bans::AccessMutex);
+		if (!Bans::Loaded) Bans::LoadBans();
 
-		Bans::BanList list;
-		Bans::LoadBans(&list);
-
-		auto entry = std::find_if(list.ipList.begin(), list.ipList.end(), [&ip](Game::netIP_t& entry)
+		// Only removes this exact range, wider ranges containing it stay banned
+		if (Bans::IPRanges.erase(ip, bits))
 		{
-			return ip.full == entry.full;
-		});
-
-		if (entry != list.ipList.end())
-		{
-			list.ipList.erase(entry);
+			Bans::Journal("-ip " + Bans::FormatRange(ip, bits));
 		}
+	}
+
+	bool Bans::unitTest()
+	{
+		printf("Testing IP range trie...");
+
+		IPTrie trie;
+		trie.insert(0x0A000000, 8); // 10.0.0.0/8
+		trie.insert(0xC0A80105, 32); // 192.168.1.5
+		trie.insert(0xAC100000, 12); // 172.16.0.0/12
+
+		auto success = trie.contains(0x0A0B0C0D) && trie.contains(0xC0A80105) && trie.contains(0xAC1F0001)
+			&& !trie.contains(0x0B000000) && !trie.contains(0xC0A80106) && !trie.contains(0xAC200000)
+			&& trie.ranges().size() == 3;
+
+		success &= trie.erase(0x0A000000, 8) && !trie.erase(0x0A000000, 8) && !trie.erase(0xC0A80100, 24);
+		success &= !trie.contains(0x0A0B0C0D) && trie.contains(0xC0A80105) && trie.ranges().size() == 2;
+
+		trie.insert(0, 0);
+		success &= trie.contains(0x01020304);
+
+		if (success) printf("Success\n");
+		else printf("Error\n");
 
-		Bans::SaveBans(&list);
+		return success;
 	}
 
 	Bans::Bans()
@@ -250,8 +525,15 @@ namespace Components
 
 			if (type == "ip"s)
 			{
-				Network::Address address(params->get(2));
-				Bans::UnbanClient(address.getIP());
+				uint32_t ip;
+				uint8_t bits;
+				if (!Bans::ParseRange(params->get(2), &ip, &bits))
+				{
+					Logger::Print("Invalid IP range %s\n", params->get(2));
+					return;
+				}
+
+				Bans::UnbanRange(ip, bits);
 
 				Logger::Print("Unbanned IP %s\n", params->get(2));
 
@@ -267,11 +549,15 @@ namespace Components
 			}
 		});
 
-		// Verify the list on startup
+		if (Loader::IsPerformingUnitTests() || ZoneBuilder::IsEnabled()) return;
+
+		// Load and verify the list on startup
 		Scheduler::Once([]()
 		{
-			Bans::BanList list;
-			Bans::LoadBans(&list);
+			std::lock_guard<std::recursive_mutex> _(Bans::AccessMutex);
+			Bans::LoadBans();
 		});
+
+		Scheduler::OnFrame(Bans::CheckModified);
 	}
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+// Journal records after which the ban list is compacted into bans.json
+#define BANS_COMPACT_THRESHOLD 256
+
 namespace Components
 {
 	class Bans : public Component
@@ -9,23 +12,70 @@ namespace Components
 
 		Bans();
 
+		bool unitTest() override;
+
 		static void BanClientNum(int num, const std::string& reason);
 		static void UnbanClient(SteamID id);
-		static void UnbanClient(Game::netIP_t ip);
+		static void UnbanClient(Game::netIP_t ip, uint8_t bits = 32);
 
 		static bool IsBanned(Entry entry);
 		static void InsertBan(Entry entry);
 
 	private:
-		class BanList
+		// Binary trie over the bits of IPv4 addresses, a terminal node bans every address below it
+		class IPTrie
 		{
 		public:
-			std::vector<SteamID> idList;
-			std::vector<Game::netIP_t> ipList;
+			IPTrie() { this->clear(); }
+
+			void clear();
+			void insert(uint32_t ip, uint8_t bits);
+			bool erase(uint32_t ip, uint8_t bits);
+			bool contains(uint32_t ip) const;
+			std::vector<std::pair<uint32_t, uint8_t>> ranges() const;
+
+		private:
+			class Node
+			{
+			public:
+				uint32_t children[2]; // 0 is the root, so it marks a missing child
+				bool terminal;
+			};
+
+			std::vector<Node> nodes;
 		};
 
 		static std::recursive_mutex AccessMutex;
-		static void LoadBans(BanList* list);
-		static void SaveBans(BanList* list);
+		static bool Loaded;
+
+		static std::unordered_set<uint64_t> IdSet;
+		static IPTrie IPRanges;
+
+		// Journal records are appended to bans.<generation>.journal, the snapshot in bans.json names the first journal that isn't part of it
+		static unsigned int Generation;
+		static unsigned int StaleGeneration;
+		static unsigned int JournalRecords;
+		static unsigned long long LastModified;
+
+		// Set by the worker thread when it serializes a snapshot, to tell our own writes apart from external changes
+		static std::atomic<size_t> WrittenHash;
+		static std::atomic<unsigned int> WrittenGeneration;
+
+		static std::string GetPath(const std::string& file);
+		static std::string GetJournalPath(unsigned int generation);
+		static std::vector<unsigned int> FindJournals();
+		static unsigned long long GetModifiedTime(const std::string& file);
+
+		static uint32_t GetAddress(Game::netIP_t ip);
+		static bool ParseRange(const std::string& range, uint32_t* ip, uint8_t* bits);
+		static std::string FormatRange(uint32_t ip, uint8_t bits);
+		static void UnbanRange(uint32_t ip, uint8_t bits);
+
+		static bool Apply(const std::string& record);
+		static void Journal(const std::string& record);
+
+		static void LoadBans();
+		static void Compact();
+		static void CheckModified();
 	};
 }
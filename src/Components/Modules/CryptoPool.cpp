@@ -0,0 +1,297 @@
+#include <STDInclude.hpp>
+
+namespace Components
+{
+	bool CryptoPool::Terminate;
+	std::vector<std::thread> CryptoPool::Threads;
+	std::mutex CryptoPool::Mutex;
+	std::condition_variable CryptoPool::Condition;
+
+	std::deque<CryptoPool::SignJob> CryptoPool::SignQueue;
+	std::deque<CryptoPool::VerifyJob> CryptoPool::VerifyQueue;
+
+	std::mutex CryptoPool::CompletedMutex;
+	std::vector<Utils::Slot<Scheduler::Callback>> CryptoPool::Completed;
+
+	std::mutex CryptoPool::KeyMutex;
+	std::unordered_map<std::string, Utils::Cryptography::ECC::Key> CryptoPool::KeyCache;
+
+	void CryptoPool::Sign(Utils::Cryptography::ECC::Key key, const std::string& message, Utils::Slot<SignCallback> callback)
+	{
+		std::vector<SignJob> jobs(1);
+		jobs[0].key = key;
+		jobs[0].message = message;
+		jobs[0].callback = callback;
+
+		CryptoPool::SignBatch(jobs);
+	}
+
+	bool CryptoPool::Verify(const std::string& publicKey, const std::string& message, const std::string& signature, Utils::Slot<VerifyCallback> callback)
+	{
+		std::vector<VerifyJob> jobs(1);
+		jobs[0].publicKey = publicKey;
+		jobs[0].message = message;
+		jobs[0].signature = signature;
+		jobs[0].callback = callback;
+
+		return CryptoPool::VerifyBatch(jobs);
+	}
+
+	void CryptoPool::SignBatch(std::vector<SignJob>& jobs)
+	{
+		if (CryptoPool::Threads.empty())
+		{
+			for (auto& job : jobs) CryptoPool::ProcessSign(job);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> _(CryptoPool::Mutex);
+			std::move(jobs.begin(), jobs.end(), std::back_inserter(CryptoPool::SignQueue));
+		}
+
+		jobs.clear();
+		CryptoPool::Condition.notify_all();
+	}
+
+	bool CryptoPool::VerifyBatch(std::vector<VerifyJob>& jobs)
+	{
+		if (CryptoPool::Threads.empty())
+		{
+			for (auto& job : jobs) CryptoPool::ProcessVerify(job);
+			return true;
+		}
+
+		{
+			std::lock_guard<std::mutex> _(CryptoPool::Mutex);
+
+			// Verifications come from unauthenticated packets, don't let a flood grow the queue without bounds
+			if (CryptoPool::VerifyQueue.size() + jobs.size() > CRYPTOPOOL_MAX_VERIFY_QUEUE) return false;
+
+			std::move(jobs.begin(), jobs.end(), std::back_inserter(CryptoPool::VerifyQueue));
+		}
+
+		jobs.clear();
+		CryptoPool::Condition.notify_all();
+		return true;
+	}
+
+	Utils::Cryptography::ECC::Key CryptoPool::GetPublicKey(const std::string& publicKey)
+	{
+		{
+			std::lock_guard<std::mutex> _(CryptoPool::KeyMutex);
+
+			auto key = CryptoPool::KeyCache.find(publicKey);
+			if (key != CryptoPool::KeyCache.end()) return key->second;
+		}
+
+		Utils::Cryptography::ECC::Key key;
+		key.set(publicKey);
+
+		if (key.isValid())
+		{
+			std::lock_guard<std::mutex> _(CryptoPool::KeyMutex);
+
+			// Connecting players are mostly the same ones, a full reset is good enough
+			if (CryptoPool::KeyCache.size() >= CRYPTOPOOL_KEY_CACHE_SIZE) CryptoPool::KeyCache.clear();
+			CryptoPool::KeyCache.emplace(publicKey, key);
+		}
+
+		return key;
+	}
+
+	void CryptoPool::Complete(Utils::Slot<Scheduler::Callback> callback)
+	{
+		// Without workers, the caller is already on the right thread
+		if (CryptoPool::Threads.empty())
+		{
+			callback();
+			return;
+		}
+
+		std::lock_guard<std::mutex> _(CryptoPool::CompletedMutex);
+		CryptoPool::Completed.push_back(callback);
+	}
+
+	void CryptoPool::ProcessSign(SignJob& job)
+	{
+		const auto signature = Utils::Cryptography::ECC::SignMessage(job.key, job.message);
+		if (!job.callback) return;
+
+		CryptoPool::Complete([callback = job.callback, signature]()
+		{
+			callback(signature);
+		});
+	}
+
+	void CryptoPool::ProcessVerify(VerifyJob& job)
+	{
+		auto key = CryptoPool::GetPublicKey(job.publicKey);
+		const auto valid = key.isValid() && Utils::Cryptography::ECC::VerifyMessage(key, job.message, job.signature);
+		if (!job.callback) return;
+
+		CryptoPool::Complete([callback = job.callback, valid]()
+		{
+			callback(valid);
+		});
+	}
+
+	void CryptoPool::RunCompleted()
+	{
+		std::vector<Utils::Slot<Scheduler::Callback>> completed;
+
+		{
+			std::lock_guard<std::mutex> _(CryptoPool::CompletedMutex);
+			completed.swap(CryptoPool::Completed);
+		}
+
+		for (auto& callback : completed)
+		{
+			callback();
+		}
+	}
+
+	void CryptoPool::Worker()
+	{
+		std::vector<SignJob> signJobs;
+		std::vector<VerifyJob> verifyJobs;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(CryptoPool::Mutex);
+				CryptoPool::Condition.wait(lock, []
+				{
+					return CryptoPool::Terminate || !CryptoPool::SignQueue.empty() || !CryptoPool::VerifyQueue.empty();
+				});
+
+				if (CryptoPool::Terminate) break;
+
+				// Take a share of each queue, so neither starves and other workers get some too
+				const auto threads = CryptoPool::Threads.size();
+				const auto signCount = std::clamp<size_t>(CryptoPool::SignQueue.size() / threads, 1, CRYPTOPOOL_BATCH_SIZE);
+				const auto verifyCount = std::clamp<size_t>(CryptoPool::VerifyQueue.size() / threads, 1, CRYPTOPOOL_BATCH_SIZE);
+
+				for (size_t i = 0; i < verifyCount && !CryptoPool::VerifyQueue.empty(); ++i)
+				{
+					verifyJobs.push_back(std::move(CryptoPool::VerifyQueue.front()));
+					CryptoPool::VerifyQueue.pop_front();
+				}
+
+				for (size_t i = 0; i < signCount && !CryptoPool::SignQueue.empty(); ++i)
+				{
+					signJobs.push_back(std::move(CryptoPool::SignQueue.front()));
+					CryptoPool::SignQueue.pop_front();
+				}
+			}
+
+			for (auto& job : verifyJobs) CryptoPool::ProcessVerify(job);
+			for (auto& job : signJobs) CryptoPool::ProcessSign(job);
+
+			verifyJobs.clear();
+			signJobs.clear();
+		}
+	}
+
+	CryptoPool::CryptoPool()
+	{
+		Scheduler::OnFrame(CryptoPool::RunCompleted);
+
+		if (Loader::IsPerformingUnitTests() || ZoneBuilder::IsEnabled()) return;
+
+		// Keep one core for the game
+		const auto threads = std::clamp<unsigned int>(std::thread::hardware_concurrency(), 2, CRYPTOPOOL_MAX_THREADS + 1) - 1;
+
+		CryptoPool::Terminate = false;
+		for (unsigned int i = 0; i < threads; ++i)
+		{
+			CryptoPool::Threads.emplace_back(CryptoPool::Worker);
+		}
+	}
+
+	CryptoPool::~CryptoPool()
+	{
+		CryptoPool::SignQueue.clear();
+		CryptoPool::VerifyQueue.clear();
+		CryptoPool::Completed.clear();
+		CryptoPool::KeyCache.clear();
+	}
+
+	void CryptoPool::preDestroy()
+	{
+		{
+			std::lock_guard<std::mutex> _(CryptoPool::Mutex);
+			CryptoPool::Terminate = true;
+		}
+
+		CryptoPool::Condition.notify_all();
+
+		for (auto& thread : CryptoPool::Threads)
+		{
+			if (thread.joinable()) thread.join();
+		}
+
+		CryptoPool::Threads.clear();
+	}
+
+	bool CryptoPool::unitTest()
+	{
+		printf("Testing batched signatures...");
+
+		auto key = Utils::Cryptography::ECC::GenerateKey(512);
+		const auto publicKey = key.getPublicKey();
+
+		std::vector<SignJob> signJobs(32);
+		std::vector<std::string> messages(signJobs.size());
+		std::vector<std::string> signatures(signJobs.size());
+
+		for (size_t i = 0; i < signJobs.size(); ++i)
+		{
+			messages[i] = Utils::Cryptography::Rand::GenerateChallenge();
+
+			signJobs[i].key = key;
+			signJobs[i].message = messages[i];
+			signJobs[i].callback = [&signatures, i](const std::string& signature)
+			{
+				signatures[i] = signature;
+			};
+		}
+
+		CryptoPool::SignBatch(signJobs);
+		CryptoPool::RunCompleted();
+
+		unsigned int valid = 0;
+		unsigned int invalid = 0;
+		std::vector<VerifyJob> verifyJobs(signatures.size() * 2);
+
+		for (size_t i = 0; i < signatures.size(); ++i)
+		{
+			verifyJobs[i * 2].publicKey = publicKey;
+			verifyJobs[i * 2].message = messages[i];
+			verifyJobs[i * 2].signature = signatures[i];
+			verifyJobs[i * 2].callback = [&valid](bool result) { if (result) ++valid; };
+
+			// Invalidate the message...
+			auto tampered = messages[i];
+			++tampered[i % tampered.size()];
+
+			verifyJobs[i * 2 + 1].publicKey = publicKey;
+			verifyJobs[i * 2 + 1].message = tampered;
+			verifyJobs[i * 2 + 1].signature = signatures[i];
+			verifyJobs[i * 2 + 1].callback = [&invalid](bool result) { if (!result) ++invalid; };
+		}
+
+		CryptoPool::VerifyBatch(verifyJobs);
+		CryptoPool::RunCompleted();
+
+		if (valid != signatures.size() || invalid != signatures.size())
+		{
+			printf("Error\n");
+			printf("%u of %u signatures were accepted and %u of %u tampered ones rejected!\n", valid, signatures.size(), invalid, signatures.size());
+			return false;
+		}
+
+		printf("Success\n");
+		return true;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#define CRYPTOPOOL_MAX_THREADS 4
+#define CRYPTOPOOL_BATCH_SIZE 16
+#define CRYPTOPOOL_KEY_CACHE_SIZE 1024
+#define CRYPTOPOOL_MAX_VERIFY_QUEUE 1024
+
+namespace Components
+{
+	// Runs ECC signing and verification on worker threads, callbacks are invoked on the main thread
+	class CryptoPool : public Component
+	{
+	public:
+		typedef void(SignCallback)(const std::string& signature);
+		typedef void(VerifyCallback)(bool valid);
+
+		class SignJob
+		{
+		public:
+			Utils::Cryptography::ECC::Key key;
+			std::string message;
+			Utils::Slot<SignCallback> callback;
+		};
+
+		class VerifyJob
+		{
+		public:
+			std::string publicKey;
+			std::string message;
+			std::string signature;
+			Utils::Slot<VerifyCallback> callback;
+		};
+
+		CryptoPool();
+		~CryptoPool();
+
+		void preDestroy() override;
+		bool unitTest() override;
+
+		static void Sign(Utils::Cryptography::ECC::Key key, const std::string& message, Utils::Slot<SignCallback> callback);
+		static bool Verify(const std::string& publicKey, const std::string& message, const std::string& signature, Utils::Slot<VerifyCallback> callback);
+
+		// Queues all jobs at once, so workers can pick them up in batches
+		static void SignBatch(std::vector<SignJob>& jobs);
+
+		// Returns false without queueing anything if the batch doesn't fit into the verify queue
+		static bool VerifyBatch(std::vector<VerifyJob>& jobs);
+
+		// Imported public keys are cached, repeated verifications skip the point decoding
+		static Utils::Cryptography::ECC::Key GetPublicKey(const std::string& publicKey);
+
+	private:
+		static bool Terminate;
+		static std::vector<std::thread> Threads;
+		static std::mutex Mutex;
+		static std::condition_variable Condition;
+
+		// Guarded by Mutex
+		static std::deque<SignJob> SignQueue;
+		static std::deque<VerifyJob> VerifyQueue;
+
+		static std::mutex CompletedMutex;
+		static std::vector<Utils::Slot<Scheduler::Callback>> Completed;
+
+		static std::mutex KeyMutex;
+		static std::unordered_map<std::string, Utils::Cryptography::ECC::Key> KeyCache;
+
+		static void Complete(Utils::Slot<Scheduler::Callback> callback);
+		static void ProcessSign(SignJob& job);
+		static void ProcessVerify(VerifyJob& job);
+		static void RunCompleted();
+		static void Worker();
+	};
+}
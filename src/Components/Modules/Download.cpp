@@ -10,6 +10,19 @@ namespace Components
 	bool Download::Terminate;
     bool Download::ServerRunning;
 
+	std::mutex Download::ManifestMutex;
+	std::atomic<bool> Download::ManifestRequested;
+	Download::Manifest Download::ModManifest;
+	Download::Manifest Download::MapManifest;
+	std::future<void> Download::ManifestTask;
+
+	Dvar::Var Download::RateLimit;
+	Dvar::Var Download::GlobalRateLimit;
+	Dvar::Var Download::MaxTransfers;
+	Utils::TokenBucket Download::GlobalBucket;
+	unsigned int Download::ActiveTransfers;
+	std::deque<mg_connection*> Download::TransferQueue;
+
 #pragma region Client
 
 	void Download::InitiateMapDownload(const std::string& map, bool needPassword)
@@ -51,6 +64,7 @@ namespace Components
 		Download::CLDownload.lastTimeStamp = 0;
 		Download::CLDownload.downBytes = 0;
 		Download::CLDownload.timeStampBytes = 0;
+		Download::CLDownload.completedFiles = 0;
 		Download::CLDownload.isPrivate = needPassword;
 		Download::CLDownload.target = Party::Target();
 		Download::CLDownload.thread = std::thread(Download::ModDownloader, &Download::CLDownload);
@@ -97,41 +111,6 @@ namespace Components
 		return true;
 	}
 
-	void Download::DownloadHandler(mg_connection *nc, int ev, void* ev_data)
-	{
-		http_message* hm = reinterpret_cast<http_message*>(ev_data);
-		Download::FileDownload* fDownload = reinterpret_cast<Download::FileDownload*>(nc->mgr->user_data);
-
-		if (ev == MG_EV_CONNECT)
-		{
-			if (hm->message.p)
-			{
-				fDownload->downloading = true;
-				return;
-			}
-		}
-
-		if (ev == MG_EV_CLOSE)
-		{
-			fDownload->downloading = false;
-			return;
-		}
-
-		if (ev == MG_EV_RECV)
-		{
-			size_t bytes = static_cast<size_t>(*reinterpret_cast<int*>(ev_data));
-			Download::DownloadProgress(fDownload, bytes);
-		}
-
-		if (ev == MG_EV_HTTP_REPLY)
-		{
-			nc->flags |= MG_F_CLOSE_IMMEDIATELY;
-			fDownload->buffer = std::string(hm->body.p, hm->body.len);
-			fDownload->downloading = false;
-			return;
-		}
-	}
-
 	bool Download::DownloadFile(ClientDownload* download, unsigned int index)
 	{
 		if (!download || download->files.size() <= index) return false;
@@ -144,33 +123,26 @@ namespace Components
 			path = "usermaps/" + path;
 		}
 
+		Download::FileDownload fDownload;
+		fDownload.file = file;
+		fDownload.index = index;
+		fDownload.download = download;
+		fDownload.downloading = true;
+		fDownload.receivedBytes = 0;
+
 		if (Utils::IO::FileExists(path))
 		{
-			std::string data = Utils::IO::ReadFile(path);
-
-			if (data.size() == file.size && Utils::String::DumpHex(Utils::Cryptography::SHA256::Compute(data), "") == file.hash)
+			size_t size = 0;
+			if (Utils::Cryptography::SHA256::ComputeFile(path, true, &size) == file.hash && size == file.size)
 			{
-				download->totalBytes += file.size;
+				Download::DownloadProgress(&fDownload, file.size);
 				return true;
 			}
 		}
 
 		std::string host = "http://" + download->target.getString();
 		std::string fastHost = Dvar::Var("sv_wwwBaseUrl").get<std::string>();
-		if (Utils::String::StartsWith(fastHost, "https://"))
-		{
-			download->thread.detach();
-			download->clear();
-
-			Scheduler::Once([]()
-			{
-				Command::Execute("closemenu mod_download_popmenu");
-				Party::ConnectError("HTTPS not supported for downloading!");
-			});
-
-			return 0;
-		}
-		else if (!Utils::String::StartsWith(fastHost, "http://"))
+		if (!Utils::String::StartsWith(fastHost, "http://"))
 		{
 			fastHost = "http://" + fastHost;
 		}
@@ -203,62 +175,87 @@ namespace Components
 
 		Logger::Print("Downloading from url %s\n", url.data());
 
-		Download::FileDownload fDownload;
-		fDownload.file = file;
-		fDownload.index = index;
-		fDownload.download = download;
-		fDownload.downloading = true;
-		fDownload.receivedBytes = 0;
-
 		Utils::String::Replace(url, " ", "%20");
 
-		// Just a speedtest ;)
-		//download->totalBytes = 1048576000;
-		//url = "http://speed.hetzner.de/1GB.bin";
+		if (download->isMap) Utils::IO::CreateDir("usermaps/" + download->mod);
+
+		// Data is streamed into a temporary file and hashed as it arrives, partial files from earlier attempts are resumed
+		std::string partPath = path + ".part";
 
-		download->valid = true;
-		/*ZeroMemory(&download->mgr, sizeof download->mgr);
-		mg_mgr_init(&download->mgr, &fDownload);
-		mg_connect_http(&download->mgr, Download::DownloadHandler, url.data(), nullptr, nullptr);
+		Utils::Cryptography::SHA256 hash;
 
-		while (fDownload.downloading && !fDownload.download->terminateThread)
+		size_t offset = 0;
+		if (Utils::IO::FileExists(partPath) && (!hash.updateFile(partPath, &offset) || offset > file.size))
 		{
-			mg_mgr_poll(&download->mgr, 100);
+			hash = Utils::Cryptography::SHA256();
+			offset = 0;
 		}
 
-		mg_mgr_free(&download->mgr);*/
+		std::ofstream stream(partPath, std::ios::binary | (offset ? std::ios::app : std::ios::trunc));
+		if (!stream.is_open()) return false;
 
-		fDownload.downloading = true;
+		Download::DownloadProgress(&fDownload, offset);
 
-		Utils::WebIO webIO;
-		webIO.setProgressCallback([&fDownload, &webIO](size_t bytes, size_t)
+		auto verified = false;
+		for (int attempt = 0; attempt < DOWNLOAD_MAX_RETRIES && !download->terminateThread; ++attempt)
 		{
-			if(!fDownload.downloading || fDownload.download->terminateThread)
+			if (offset < file.size)
 			{
-				webIO.cancelDownload();
-				return;
+				Utils::WebIO webIO;
+				webIO.stream(url, [&](const char* data, size_t size)
+				{
+					if (download->terminateThread)
+					{
+						webIO.cancelDownload();
+						return;
+					}
+
+					// Never write past the announced size, a misbehaving server would otherwise grow the file forever
+					size = std::min(size, file.size - offset);
+					if (!size)
+					{
+						webIO.cancelDownload();
+						return;
+					}
+
+					stream.write(data, size);
+					hash.update(reinterpret_cast<const uint8_t*>(data), size);
+					offset += size;
+
+					Download::DownloadProgress(&fDownload, size);
+				}, offset);
 			}
 
-			Download::DownloadProgress(&fDownload, bytes - fDownload.receivedBytes);
-		});
+			// Dropped connections resume from what we have
+			if (offset < file.size) continue;
 
-		bool result = false;
-		fDownload.buffer = webIO.get(url, &result);
-		if (!result) fDownload.buffer.clear();
+			if (hash.finalize(true) == file.hash)
+			{
+				verified = true;
+				break;
+			}
+
+			// Corrupt, start over and take its bytes out of the progress again
+			Download::DiscardProgress(&fDownload);
 
-		fDownload.downloading = false;
+			stream.close();
+			stream.open(partPath, std::ios::binary | std::ios::trunc);
+			if (!stream.is_open()) return false;
+
+			hash = Utils::Cryptography::SHA256();
+			offset = 0;
+		}
 
-		download->valid = false;
+		stream.close();
 
-		if (fDownload.buffer.size() != file.size || Utils::Cryptography::SHA256::Compute(fDownload.buffer, true) != file.hash)
+		if (!verified)
 		{
+			// Keep an incomplete file around for the next attempt, but never a corrupt one
+			if (!offset) Utils::IO::RemoveFile(partPath);
 			return false;
 		}
 
-		if (download->isMap) Utils::IO::CreateDir("usermaps/" + download->mod);
-		Utils::IO::WriteFile(path, fDownload.buffer);
-
-		return true;
+		return MoveFileExA(partPath.data(), path.data(), MOVEFILE_REPLACE_EXISTING) != FALSE;
 	}
 
 	void Download::ModDownloader(ClientDownload* download)
@@ -269,7 +266,14 @@ namespace Components
 
 		std::string listUrl = host + (download->isMap ? "/map" : "/list") + (download->isPrivate ? ("?password=" + download->hashedPassword) : "");
 
-		std::string list = Utils::WebIO("IW4x", listUrl).setTimeout(5000)->get();
+		// The server answers 503 while it's hashing its files, give it a few seconds
+		std::string list;
+		for (int i = 0; i < DOWNLOAD_LIST_ATTEMPTS && list.empty() && !download->terminateThread; ++i)
+		{
+			if (i) std::this_thread::sleep_for(1s);
+			list = Utils::WebIO("IW4x", listUrl).setTimeout(5000)->get();
+		}
+
 		if (list.empty())
 		{
 			if (download->terminateThread) return;
@@ -309,33 +313,70 @@ namespace Components
 		static std::string mod;
 		mod = download->mod;
 
-		for (unsigned int i = 0; i < download->files.size(); ++i)
+		if (Utils::String::StartsWith(Dvar::Var("sv_wwwBaseUrl").get<std::string>(), "https://"))
 		{
-			if (download->terminateThread) return;
+			download->thread.detach();
+			download->clear();
 
-			if (!Download::DownloadFile(download, i))
+			Scheduler::Once([]()
 			{
-				if (download->terminateThread) return;
+				Command::Execute("closemenu mod_download_popmenu");
+				Party::ConnectError("HTTPS not supported for downloading!");
+			});
 
-				mod = Utils::String::VA("Failed to download file: %s!", download->files[i].name.data());
-				download->thread.detach();
-				download->clear();
+			return;
+		}
 
-				Scheduler::Once([]()
-				{
-					Dvar::Var("partyend_reason").set(mod);
-					mod.clear();
+		// Fetch several files at once, workers pick the next pending file until one of them fails
+		std::atomic<unsigned int> nextFile = 0;
+		std::atomic<bool> failed = false;
+		unsigned int failedFile = 0;
+		std::mutex failedMutex;
 
-					Command::Execute("closemenu mod_download_popmenu");
-					Command::Execute("openmenu menu_xboxlive_partyended");
-				});
+		unsigned int workerCount = std::min(static_cast<unsigned int>(std::max(1, Dvar::Var("cl_downloadConcurrency").get<int>())), download->files.size());
 
-				return;
-			}
+		std::vector<std::thread> workers;
+		for (unsigned int i = 0; i < workerCount; ++i)
+		{
+			workers.emplace_back([&]()
+			{
+				for (unsigned int index = nextFile++; index < download->files.size() && !failed && !download->terminateThread; index = nextFile++)
+				{
+					if (!Download::DownloadFile(download, index))
+					{
+						std::lock_guard<std::mutex> _(failedMutex);
+						if (!failed) failedFile = index;
+						failed = true;
+					}
+				}
+			});
+		}
+
+		for (auto& worker : workers)
+		{
+			worker.join();
 		}
 
 		if (download->terminateThread) return;
 
+		if (failed)
+		{
+			mod = Utils::String::VA("Failed to download file: %s!", download->files[failedFile].name.data());
+			download->thread.detach();
+			download->clear();
+
+			Scheduler::Once([]()
+			{
+				Dvar::Var("partyend_reason").set(mod);
+				mod.clear();
+
+				Command::Execute("closemenu mod_download_popmenu");
+				Command::Execute("openmenu menu_xboxlive_partyended");
+			});
+
+			return;
+		}
+
 		download->thread.detach();
 		download->clear();
 
@@ -397,9 +438,29 @@ namespace Components
 		return nullptr;
 	}
 
+	void Download::DiscardProgress(FileDownload* fDownload)
+	{
+		std::lock_guard<std::mutex> _(fDownload->download->progressMutex);
+
+		if (fDownload->receivedBytes >= fDownload->file.size && fDownload->receivedBytes)
+		{
+			--fDownload->download->completedFiles;
+		}
+
+		fDownload->download->downBytes -= std::min(fDownload->download->downBytes, fDownload->receivedBytes);
+		fDownload->receivedBytes = 0;
+	}
+
 	void Download::DownloadProgress(FileDownload* fDownload, size_t bytes)
 	{
+		std::lock_guard<std::mutex> _(fDownload->download->progressMutex);
+
 		fDownload->receivedBytes += bytes;
+		if (fDownload->receivedBytes >= fDownload->file.size && bytes)
+		{
+			++fDownload->download->completedFiles;
+		}
+
 		fDownload->download->downBytes += bytes;
 		fDownload->download->timeStampBytes += bytes;
 
@@ -414,7 +475,7 @@ namespace Components
 			}
 
 			static unsigned int dlIndex, dlSize, dlProgress;
-			dlIndex = fDownload->index + 1;
+			dlIndex = std::min(fDownload->download->completedFiles + 1, fDownload->download->files.size());
 			dlSize = fDownload->download->files.size();
 			dlProgress = static_cast<unsigned int>(progress);
 
@@ -495,6 +556,18 @@ namespace Components
 		nc->flags |= MG_F_SEND_AND_CLOSE;
 	}
 
+	void Download::Busy(mg_connection *nc)
+	{
+		mg_printf(nc, "HTTP/1.1 503 Service Unavailable\r\n"
+			"Content-Type: text/html\r\n"
+			"Retry-After: 1\r\n"
+			"Connection: close\r\n"
+			"\r\n"
+			"503 - Busy, retry later");
+
+		nc->flags |= MG_F_SEND_AND_CLOSE;
+	}
+
 	void Download::ServerlistHandler(mg_connection* nc, int ev, void* /*ev_data*/)
 	{
 		// Only handle http requests
@@ -522,47 +595,208 @@ namespace Components
 		nc->flags |= MG_F_SEND_AND_CLOSE;
 	}
 
-	void Download::MapHandler(mg_connection *nc, int ev, void* ev_data)
+	Download::Manifest Download::BuildManifest(const std::string& key, const std::string& directory, const std::vector<std::string>& files)
 	{
-		// Only handle http requests
-		if (ev != MG_EV_HTTP_REQUEST) return;
+		Download::Manifest manifest;
+		manifest.key = key;
 
-		if (!Download::VerifyPassword(nc, reinterpret_cast<http_message*>(ev_data))) return;
+		Utils::HashCache cache(directory);
+		cache.prepare(files);
+
+		std::vector<json11::Json> fileList;
+		for (auto& name : files)
+		{
+			size_t size = 0;
+			std::string hash = cache.get(name, &size);
+			if (hash.empty()) continue;
+
+			std::map<std::string, json11::Json> file;
+			file["name"] = name;
+			file["size"] = static_cast<int>(size);
+			file["hash"] = hash;
+
+			fileList.push_back(file);
+			manifest.hashes[directory + "\\" + name] = hash;
+		}
 
-		static std::string mapnamePre;
-		static json11::Json jsonList;
+		cache.save();
 
-		std::string mapname = (Party::IsInUserMapLobby() ? Dvar::Var("ui_mapname").get<std::string>() : Maps::GetUserMap()->getName());
-		if (!Maps::GetUserMap()->isValid() && !Party::IsInUserMapLobby())
+		manifest.list = json11::Json(fileList).dump();
+		return manifest;
+	}
+
+	std::string Download::GetManifestStamp(const std::string& directory, const std::vector<std::string>& files)
+	{
+		std::string stamp;
+
+		for (auto& name : files)
 		{
-			mapnamePre.clear();
-			jsonList = std::vector<json11::Json>();
+			size_t size;
+			unsigned long long modified;
+
+			stamp.append(name);
+			if (Utils::HashCache::GetFileInfo(directory + "\\" + name, &size, &modified))
+			{
+				stamp.append(Utils::String::VA(":%u:%llu", size, modified));
+			}
+
+			stamp.append(";");
 		}
-		else if (!mapname.empty() && mapname != mapnamePre)
+
+		return stamp;
+	}
+
+	std::string Download::GetModList(const std::string& fsGame)
+	{
+		if (fsGame.empty()) return "[]";
+
+		std::lock_guard<std::mutex> _(Download::ManifestMutex);
+		if (Download::ModManifest.key == fsGame) return Download::ModManifest.list;
+
+		// Hashing is never done on the poll thread, the client retries until the background build is done
+		Download::ManifestRequested = true;
+		return "";
+	}
+
+	std::string Download::GetMapList(const std::string& mapname)
+	{
+		if (mapname.empty()) return "[]";
+
+		std::lock_guard<std::mutex> _(Download::ManifestMutex);
+		if (Download::MapManifest.key == mapname) return Download::MapManifest.list;
+
+		Download::ManifestRequested = true;
+		return "";
+	}
+
+	void Download::UpdateModManifest(const std::string& fsGame)
+	{
+		if (fsGame.empty()) return;
+
+		std::string path = Dvar::Var("fs_basepath").get<std::string>() + "\\" + fsGame;
+		auto list = FileSystem::GetSysFileList(path, "iwd", false);
+		list.push_back("mod.ff");
+
+		list.erase(std::remove_if(list.begin(), list.end(), [](const std::string& file)
 		{
-			std::vector<json11::Json> fileList;
+			return strstr(file.data(), "_svr_") != nullptr;
+		}), list.end());
 
-			mapnamePre = mapname;
+		// Rebuild when the key changed or any file was added, removed or replaced
+		auto stamp = Download::GetManifestStamp(path, list);
 
-			std::string path = Dvar::Var("fs_basepath").get<std::string>() + "\\usermaps\\" + mapname;
+		{
+			std::lock_guard<std::mutex> _(Download::ManifestMutex);
+			if (Download::ModManifest.key == fsGame && Download::ModManifest.stamp == stamp) return;
+		}
 
-			for (int i = 0; i < ARRAYSIZE(Maps::UserMapFiles); ++i)
-			{
-				std::string filename = path + "\\" + mapname + Maps::UserMapFiles[i];
-				if (Utils::IO::FileExists(filename))
-				{
-					std::map<std::string, json11::Json> file;
-					std::string fileBuffer = Utils::IO::ReadFile(filename);
+		auto manifest = Download::BuildManifest(fsGame, path, list);
+		manifest.stamp = stamp;
 
-					file["name"] = mapname + Maps::UserMapFiles[i];
-					file["size"] = static_cast<int>(fileBuffer.size());
-					file["hash"] = Utils::Cryptography::SHA256::Compute(fileBuffer, true);
+		std::lock_guard<std::mutex> _(Download::ManifestMutex);
+		Download::ModManifest = manifest;
+	}
 
-					fileList.push_back(file);
-				}
+	void Download::UpdateMapManifest(const std::string& mapname)
+	{
+		if (mapname.empty()) return;
+
+		std::string path = Dvar::Var("fs_basepath").get<std::string>() + "\\usermaps\\" + mapname;
+
+		std::vector<std::string> list;
+		for (int i = 0; i < ARRAYSIZE(Maps::UserMapFiles); ++i)
+		{
+			list.push_back(mapname + Maps::UserMapFiles[i]);
+		}
+
+		auto stamp = Download::GetManifestStamp(path, list);
+
+		{
+			std::lock_guard<std::mutex> _(Download::ManifestMutex);
+			if (Download::MapManifest.key == mapname && Download::MapManifest.stamp == stamp) return;
+		}
+
+		auto manifest = Download::BuildManifest(mapname, path, list);
+		manifest.stamp = stamp;
+
+		std::lock_guard<std::mutex> _(Download::ManifestMutex);
+		Download::MapManifest = manifest;
+	}
+
+	std::string Download::GetManifestMapname()
+	{
+		// Party clients download the map selected in the lobby, before it is loaded
+		if (Party::IsInUserMapLobby()) return Dvar::Var("ui_mapname").get<std::string>();
+		return (Maps::GetUserMap()->isValid() ? Maps::GetUserMap()->getName() : "");
+	}
+
+	std::string Download::GetFileHash(const std::string& path)
+	{
+		std::lock_guard<std::mutex> _(Download::ManifestMutex);
+
+		for (auto* manifest : { &Download::ModManifest, &Download::MapManifest })
+		{
+			auto hash = manifest->hashes.find(path);
+			if (hash != manifest->hashes.end())
+			{
+				return hash->second;
 			}
+		}
+
+		return "";
+	}
+
+	void Download::PrepareManifests()
+	{
+		static Utils::Time::Interval interval;
+		if (!interval.elapsed(1s) && !Download::ManifestRequested) return;
+		interval.update();
+
+		// Don't queue another build while the previous one is still running
+		if (Download::ManifestTask.valid() && Download::ManifestTask.wait_for(0ms) != std::future_status::ready) return;
+
+		std::string fsGame = Dvar::Var("fs_game").get<std::string>();
+		std::string mapname = Download::GetManifestMapname();
+		if (fsGame.empty() && mapname.empty()) return;
+
+		// Files are re-stat'ed periodically, so replaced iwds or maps get new hashes
+		static Utils::Time::Interval rescan;
+		static std::string fsGamePre, mapnamePre;
+		if (fsGame == fsGamePre && mapname == mapnamePre && !Download::ManifestRequested && !rescan.elapsed(std::chrono::milliseconds(DOWNLOAD_MANIFEST_RESCAN))) return;
+
+		rescan.update();
+		Download::ManifestRequested = false;
 
-			jsonList = fileList;
+		fsGamePre = fsGame;
+		mapnamePre = mapname;
+
+		// Hash everything in the background, so the first client doesn't have to wait for it
+		Download::ManifestTask = std::async(std::launch::async, [fsGame, mapname]()
+		{
+			Download::UpdateModManifest(fsGame);
+			Download::UpdateMapManifest(mapname);
+		});
+	}
+
+	void Download::MapHandler(mg_connection *nc, int ev, void* ev_data)
+	{
+		// Only handle http requests
+		if (ev != MG_EV_HTTP_REQUEST) return;
+
+		if (!Download::VerifyPassword(nc, reinterpret_cast<http_message*>(ev_data))) return;
+
+		std::string list = "[]";
+
+		std::string mapname = Download::GetManifestMapname();
+		if (!mapname.empty())
+		{
+			list = Download::GetMapList(mapname);
+		}
+
+		if (list.empty())
+		{
+			Download::Busy(nc);
+			return;
 		}
 
 		mg_printf(nc,
@@ -570,7 +804,7 @@ namespace Components
 			"Content-Type: application/json\r\n"
 			"Connection: close\r\n"
 			"\r\n"
-			"%s", jsonList.dump().data());
+			"%s", list.data());
 
 		nc->flags |= MG_F_SEND_AND_CLOSE;
 	}
@@ -588,39 +822,11 @@ namespace Components
 // 		}
 // 		else
 		{
-			static std::string fsGamePre;
-			static json11::Json jsonList;
-
-			std::string fsGame = Dvar::Var("fs_game").get<std::string>();
-
-			if (!fsGame.empty() && fsGame != fsGamePre)
+			std::string list = Download::GetModList(Dvar::Var("fs_game").get<std::string>());
+			if (list.empty())
 			{
-				std::vector<json11::Json> fileList;
-
-				fsGamePre = fsGame;
-
-				std::string path = Dvar::Var("fs_basepath").get<std::string>() + "\\" + fsGame;
-				auto list = FileSystem::GetSysFileList(path, "iwd", false);
-
-				list.push_back("mod.ff");
-
-				for (auto i = list.begin(); i != list.end(); ++i)
-				{
-					std::string filename = path + "\\" + *i;
-					if (strstr(i->data(), "_svr_") == nullptr && Utils::IO::FileExists(filename))
-					{
-						std::map<std::string, json11::Json> file;
-						std::string fileBuffer = Utils::IO::ReadFile(filename);
-
-						file["name"] = *i;
-						file["size"] = static_cast<int>(fileBuffer.size());
-						file["hash"] = Utils::Cryptography::SHA256::Compute(fileBuffer, true);
-
-						fileList.push_back(file);
-					}
-				}
-
-				jsonList = fileList;
+				Download::Busy(nc);
+				return;
 			}
 
 			mg_printf(nc,
@@ -628,7 +834,7 @@ namespace Components
 				"Content-Type: application/json\r\n"
 				"Connection: close\r\n"
 				"\r\n"
-				"%s", jsonList.dump().data());
+				"%s", list.data());
 
 			nc->flags |= MG_F_SEND_AND_CLOSE;
 		}
@@ -694,11 +900,10 @@ namespace Components
 				}
 			}
 
-			std::string file;
 			std::string fsGame = Dvar::Var("fs_game").get<std::string>();
 			std::string path = Dvar::Var("fs_basepath").get<std::string>() + "\\" + (isMap ? "" : fsGame + "\\") + url;
 
-			if ((!isMap && fsGame.empty()) || !Utils::IO::ReadFile(path, &file))
+			if ((!isMap && fsGame.empty()) || !Utils::IO::FileExists(path))
 			{
 				mg_printf(nc,
 					"HTTP/1.1 404 Not Found\r\n"
@@ -706,20 +911,230 @@ namespace Components
 					"Connection: close\r\n"
 					"\r\n"
 					"404 - Not Found %s", path.data());
+
+				nc->flags |= MG_F_SEND_AND_CLOSE;
+				return;
 			}
-			else
+
+			auto* stream = new Download::FileStream();
+			stream->path = path;
+
+			if (mg_str* range = mg_get_http_header(message, "Range"))
 			{
+				stream->range = std::string(range->p, range->len);
+			}
+
+			if (mg_str* ifNoneMatch = mg_get_http_header(message, "If-None-Match"))
+			{
+				stream->ifNoneMatch = std::string(ifNoneMatch->p, ifNoneMatch->len);
+			}
+
+			// Transfers beyond sv_downloadMaxTransfers wait in line, see Download::ScheduleTransfers
+			nc->user_data = stream;
+			Download::TransferQueue.push_back(nc);
+			Download::ScheduleTransfers();
+		}
+	}
+
+	bool Download::ParseRange(const std::string& range, size_t fileSize, size_t* start, size_t* end)
+	{
+		*start = 0;
+		*end = fileSize ? fileSize - 1 : 0;
+
+		// Only a single range is supported, multipart responses are not worth it for our clients
+		if (!Utils::String::StartsWith(range, "bytes=") || range.find(',') != std::string::npos) return true;
+
+		auto separator = range.find('-');
+		if (separator == std::string::npos) return true;
+
+		std::string first = range.substr(6, separator - 6);
+		std::string last = range.substr(separator + 1);
+
+		if (first.empty())
+		{
+			// Suffix range, the last n bytes
+			size_t length = strtoul(last.data(), nullptr, 10);
+			if (length == 0 || fileSize == 0) return false;
+
+			*start = fileSize - std::min(length, fileSize);
+		}
+		else
+		{
+			*start = strtoul(first.data(), nullptr, 10);
+			if (!last.empty()) *end = std::min(static_cast<size_t>(strtoul(last.data(), nullptr, 10)), *end);
+		}
+
+		return (*start < fileSize && *start <= *end);
+	}
+
+	void Download::StartFileStream(mg_connection *nc)
+	{
+		auto* stream = reinterpret_cast<Download::FileStream*>(nc->user_data);
+		if (!stream) return;
+
+		stream->active = true;
+		++Download::ActiveTransfers;
+
+		stream->handle.open(stream->path, std::ios::binary);
+
+		if (!stream->handle.is_open())
+		{
+			Download::CloseFileStream(nc);
+			Download::Forbid(nc);
+			return;
+		}
+
+		stream->handle.seekg(0, std::ios::end);
+		size_t fileSize = static_cast<size_t>(stream->handle.tellg());
+
+		std::string etag;
+		std::string hash = Download::GetFileHash(stream->path);
+		if (!hash.empty())
+		{
+			etag = "\"" + hash + "\"";
+
+			if (stream->ifNoneMatch == etag || stream->ifNoneMatch == hash)
+			{
+				Download::CloseFileStream(nc);
+
 				mg_printf(nc,
-					"HTTP/1.1 200 OK\r\n"
-					"Content-Type: application/octet-stream\r\n"
-					"Content-Length: %d\r\n"
+					"HTTP/1.1 304 Not Modified\r\n"
+					"ETag: %s\r\n"
 					"Connection: close\r\n"
-					"\r\n", file.size());
+					"\r\n", etag.data());
 
-				mg_send(nc, file.data(), static_cast<int>(file.size()));
+				nc->flags |= MG_F_SEND_AND_CLOSE;
+				return;
 			}
+		}
+
+		size_t start, end;
+		if (!Download::ParseRange(stream->range, fileSize, &start, &end))
+		{
+			Download::CloseFileStream(nc);
+
+			mg_printf(nc,
+				"HTTP/1.1 416 Range Not Satisfiable\r\n"
+				"Content-Range: bytes */%u\r\n"
+				"Connection: close\r\n"
+				"\r\n", fileSize);
 
 			nc->flags |= MG_F_SEND_AND_CLOSE;
+			return;
+		}
+
+		stream->remaining = fileSize ? (end - start + 1) : 0;
+		stream->handle.seekg(start, std::ios::beg);
+
+		bool partial = (stream->remaining != fileSize);
+
+		mg_printf(nc,
+			"HTTP/1.1 %s\r\n"
+			"Content-Type: application/octet-stream\r\n"
+			"Content-Length: %u\r\n"
+			"Accept-Ranges: bytes\r\n"
+			"%s%s%s"
+			"Connection: close\r\n",
+			(partial ? "206 Partial Content" : "200 OK"), stream->remaining,
+			(etag.empty() ? "" : "ETag: "), etag.data(), (etag.empty() ? "" : "\r\n"));
+
+		if (partial)
+		{
+			mg_printf(nc, "Content-Range: bytes %u-%u/%u\r\n", start, end, fileSize);
+		}
+
+		mg_printf(nc, "\r\n");
+
+		// The body is sent from disk as the send buffer drains, see Download::StreamFile
+		Download::StreamFile(nc);
+	}
+
+	void Download::StreamFile(mg_connection *nc)
+	{
+		auto* stream = reinterpret_cast<Download::FileStream*>(nc->user_data);
+		if (!stream || !stream->active) return;
+
+		size_t budget = (nc->send_mbuf.len < DOWNLOAD_STREAM_WINDOW ? DOWNLOAD_STREAM_WINDOW - nc->send_mbuf.len : 0);
+
+		// Rates are given in KB/s, buckets can hold a quarter second worth of data
+		double rate = Download::RateLimit.get<int>() * 1024.0;
+		if (rate > 0.0)
+		{
+			stream->bucket.refill(rate, std::max(rate / 4, static_cast<double>(DOWNLOAD_STREAM_CHUNK_SIZE)));
+			budget = std::min(budget, static_cast<size_t>(stream->bucket.available()));
+		}
+
+		double globalRate = Download::GlobalRateLimit.get<int>() * 1024.0;
+		if (globalRate > 0.0)
+		{
+			Download::GlobalBucket.refill(globalRate, std::max(globalRate / 4, static_cast<double>(DOWNLOAD_STREAM_CHUNK_SIZE)));
+			budget = std::min(budget, static_cast<size_t>(Download::GlobalBucket.available()));
+		}
+
+		char buffer[DOWNLOAD_STREAM_CHUNK_SIZE];
+
+		while (stream->remaining && budget)
+		{
+			stream->handle.read(buffer, std::min(std::min(sizeof(buffer), stream->remaining), budget));
+			size_t read = static_cast<size_t>(stream->handle.gcount());
+
+			if (read == 0)
+			{
+				// The file was truncated while we were sending it, the client will notice the short body
+				Download::CloseFileStream(nc);
+				nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+				return;
+			}
+
+			mg_send(nc, buffer, static_cast<int>(read));
+			stream->remaining -= read;
+			budget -= read;
+
+			if (rate > 0.0) stream->bucket.consume(static_cast<double>(read));
+			if (globalRate > 0.0) Download::GlobalBucket.consume(static_cast<double>(read));
+		}
+
+		if (!stream->remaining)
+		{
+			Download::CloseFileStream(nc);
+			nc->flags |= MG_F_SEND_AND_CLOSE;
+		}
+	}
+
+	void Download::CloseFileStream(mg_connection *nc)
+	{
+		auto* stream = reinterpret_cast<Download::FileStream*>(nc->user_data);
+		if (!stream) return;
+
+		if (stream->active)
+		{
+			--Download::ActiveTransfers;
+		}
+		else
+		{
+			auto entry = std::find(Download::TransferQueue.begin(), Download::TransferQueue.end(), nc);
+			if (entry != Download::TransferQueue.end())
+			{
+				Download::TransferQueue.erase(entry);
+			}
+		}
+
+		nc->user_data = nullptr;
+		delete stream;
+	}
+
+	void Download::ScheduleTransfers()
+	{
+		// Requests are served first come, first served once a transfer slot is free
+		while (!Download::TransferQueue.empty())
+		{
+			int maxTransfers = Download::MaxTransfers.get<int>();
+			if (maxTransfers > 0 && Download::ActiveTransfers >= static_cast<unsigned int>(maxTransfers)) break;
+
+			mg_connection* nc = Download::TransferQueue.front();
+			Download::TransferQueue.pop_front();
+
+			Download::StartFileStream(nc);
 		}
 	}
 
@@ -782,6 +1197,19 @@ namespace Components
 
 	void Download::EventHandler(mg_connection *nc, int ev, void *ev_data)
 	{
+		// Continue streaming files once the send buffer drained, endpoint handlers don't receive these events
+		if (ev == MG_EV_SEND || ev == MG_EV_POLL)
+		{
+			Download::StreamFile(nc);
+			return;
+		}
+
+		if (ev == MG_EV_CLOSE)
+		{
+			Download::CloseFileStream(nc);
+			return;
+		}
+
 		// Only handle http requests
 		if (ev != MG_EV_HTTP_REQUEST) return;
 
@@ -867,6 +1295,13 @@ namespace Components
 			ZeroMemory(&Download::Mgr, sizeof Download::Mgr);
 			mg_mgr_init(&Download::Mgr, nullptr);
 
+			Dvar::OnInit([]()
+			{
+				Download::RateLimit = Dvar::Register<int>("sv_downloadRateLimit", 0, 0, 1024 * 1024, Game::dvar_flag::DVAR_ARCHIVE, "Maximum download speed per client in KB/s, 0 for unlimited");
+				Download::GlobalRateLimit = Dvar::Register<int>("sv_downloadGlobalRateLimit", 0, 0, 1024 * 1024, Game::dvar_flag::DVAR_ARCHIVE, "Maximum combined download speed of all clients in KB/s, 0 for unlimited");
+				Download::MaxTransfers = Dvar::Register<int>("sv_downloadMaxTransfers", 8, 0, 128, Game::dvar_flag::DVAR_ARCHIVE, "Maximum number of files sent at the same time, further requests wait in line. 0 for unlimited");
+			});
+
 			Network::OnStart([]()
 			{
 				mg_connection* nc = mg_bind(&Download::Mgr, Utils::String::VA("%hu", Network::GetPort()), Download::EventHandler);
@@ -890,11 +1325,16 @@ namespace Components
 
             Download::ServerRunning = true;
 			Download::Terminate = false;
+
+			Scheduler::OnFrame(Download::PrepareManifests);
+
 			Download::ServerThread = std::thread([]
 			{
 				while (!Download::Terminate)
 				{
-					mg_mgr_poll(&Download::Mgr, 100);
+					// Poll more often while files are being sent, so rate limiting stays smooth
+					mg_mgr_poll(&Download::Mgr, Download::ActiveTransfers ? 10 : 100);
+					Download::ScheduleTransfers();
 				}
 			});
 		}
@@ -905,6 +1345,7 @@ namespace Components
 				Dvar::Register<const char*>("ui_dl_timeLeft", "", Game::dvar_flag::DVAR_NONE, "");
 				Dvar::Register<const char*>("ui_dl_progress", "", Game::dvar_flag::DVAR_NONE, "");
 				Dvar::Register<const char*>("ui_dl_transRate", "", Game::dvar_flag::DVAR_NONE, "");
+				Dvar::Register<int>("cl_downloadConcurrency", 4, 1, 16, Game::dvar_flag::DVAR_ARCHIVE, "Number of files downloaded in parallel when joining a modded server");
 			});
 
 			UIScript::Add("mod_download_cancel", [](UIScript::Token)
@@ -1018,6 +1459,11 @@ namespace Components
 			Download::ServerThread.join();
 		}
 
+		if (Download::ManifestTask.valid())
+		{
+			Download::ManifestTask.wait();
+		}
+
 		if (!Dedicated::IsEnabled())
 		{
 			Download::CLDownload.clear();
@@ -1,6 +1,12 @@
 #pragma once
 #include <Game/Functions.hpp>
 
+#define DOWNLOAD_STREAM_CHUNK_SIZE 16384
+#define DOWNLOAD_STREAM_WINDOW (256 * 1024)
+#define DOWNLOAD_MAX_RETRIES 3
+#define DOWNLOAD_LIST_ATTEMPTS 10
+#define DOWNLOAD_MANIFEST_RESCAN 10000
+
 namespace Components
 {
 	class Download : public Component
@@ -18,7 +24,7 @@ namespace Components
 		class ClientDownload
 		{
 		public:
-			ClientDownload(bool _isMap = false) : running(false), valid(false), terminateThread(false), isMap(_isMap), totalBytes(0), downBytes(0), lastTimeStamp(0), timeStampBytes(0) {}
+			ClientDownload(bool _isMap = false) : running(false), valid(false), terminateThread(false), isMap(_isMap), totalBytes(0), downBytes(0), lastTimeStamp(0), timeStampBytes(0), completedFiles(0) {}
 			~ClientDownload() { this->clear(); }
 
 			bool running;
@@ -38,6 +44,10 @@ namespace Components
 			int lastTimeStamp;
 			size_t timeStampBytes;
 
+			// Guards the progress counters above, files are downloaded in parallel
+			std::mutex progressMutex;
+			unsigned int completedFiles;
+
 			class File
 			{
 			public:
@@ -78,7 +88,6 @@ namespace Components
 			int timestamp;
 			bool downloading;
 			unsigned int index;
-			std::string buffer;
 			size_t receivedBytes;
 		};
 
@@ -205,6 +214,30 @@ namespace Components
 			}
 		};
 
+		class FileStream
+		{
+		public:
+			FileStream() : remaining(0), active(false) {}
+
+			std::string path;
+			std::string range;
+			std::string ifNoneMatch;
+
+			std::ifstream handle;
+			size_t remaining;
+			bool active;
+			Utils::TokenBucket bucket;
+		};
+
+		class Manifest
+		{
+		public:
+			std::string key;
+			std::string list;
+			std::string stamp; // Name, size and write time of every file
+			std::unordered_map<std::string, std::string> hashes;
+		};
+
 		static mg_mgr Mgr;
 		static ClientDownload CLDownload;
 		static std::vector<std::shared_ptr<ScriptDownload>> ScriptDownloads;
@@ -212,7 +245,21 @@ namespace Components
 		static bool Terminate;
         static bool ServerRunning;
 
+		static std::mutex ManifestMutex;
+		static std::atomic<bool> ManifestRequested;
+		static Manifest ModManifest;
+		static Manifest MapManifest;
+		static std::future<void> ManifestTask;
+
+		static Dvar::Var RateLimit;
+		static Dvar::Var GlobalRateLimit;
+		static Dvar::Var MaxTransfers;
+		static Utils::TokenBucket GlobalBucket;
+		static unsigned int ActiveTransfers;
+		static std::deque<mg_connection*> TransferQueue;
+
 		static void DownloadProgress(FileDownload* fDownload, size_t bytes);
+		static void DiscardProgress(FileDownload* fDownload);
 
 		static bool VerifyPassword(mg_connection *nc, http_message* message);
 
@@ -222,11 +269,28 @@ namespace Components
 		static void ServerlistHandler(mg_connection *nc, int ev, void *ev_data);
 		static void FileHandler(mg_connection *nc, int ev, void *ev_data);
 		static void InfoHandler(mg_connection *nc, int ev, void *ev_data);
-		static void DownloadHandler(mg_connection *nc, int ev, void *ev_data);
+
+		static Manifest BuildManifest(const std::string& key, const std::string& directory, const std::vector<std::string>& files);
+		static std::string GetManifestStamp(const std::string& directory, const std::vector<std::string>& files);
+		// Empty until PrepareManifests has built the manifest in the background
+		static std::string GetModList(const std::string& fsGame);
+		static std::string GetMapList(const std::string& mapname);
+		static void UpdateModManifest(const std::string& fsGame);
+		static void UpdateMapManifest(const std::string& mapname);
+		static std::string GetManifestMapname();
+		static std::string GetFileHash(const std::string& path);
+		static void PrepareManifests();
+
+		static bool ParseRange(const std::string& range, size_t fileSize, size_t* start, size_t* end);
+		static void StartFileStream(mg_connection *nc);
+		static void StreamFile(mg_connection *nc);
+		static void CloseFileStream(mg_connection *nc);
+		static void ScheduleTransfers();
 
 		static bool IsClient(mg_connection *nc);
 		static Game::client_t* GetClient(mg_connection *nc);
 		static void Forbid(mg_connection *nc);
+		static void Busy(mg_connection *nc);
 
 		static void ModDownloader(ClientDownload* download);
 		static bool ParseModList(ClientDownload* download, const std::string& list);
@@ -4,6 +4,7 @@ namespace Components
 {
 	Utils::Signal<Scheduler::Callback> Dvar::RegistrationSignal;
 	const char* Dvar::ArchiveDvarPath = "userraw/archivedvars.cfg";
+	unsigned int Dvar::ModificationEpoch = 0;
 
 	Dvar::Var::Var(const std::string& dvarName) : Var()
 	{
@@ -115,6 +116,7 @@ namespace Components
 		assert(this->dvar->type == Game::DVAR_TYPE_STRING);
 		if (this->dvar)
 		{
+			if (!this->dvar->current.string || std::strcmp(this->dvar->current.string, string)) ++Dvar::ModificationEpoch;
 			Game::Dvar_SetString(this->dvar, string);
 		}
 	}
@@ -129,6 +131,7 @@ namespace Components
 		assert(this->dvar->type == Game::DVAR_TYPE_INT);
 		if (this->dvar)
 		{
+			if (this->dvar->current.integer != integer) ++Dvar::ModificationEpoch;
 			Game::Dvar_SetInt(this->dvar, integer);
 		}
 	}
@@ -138,6 +141,7 @@ namespace Components
 		assert(this->dvar->type == Game::DVAR_TYPE_FLOAT);
 		if (this->dvar)
 		{
+			if (this->dvar->current.value != value) ++Dvar::ModificationEpoch;
 			Game::Dvar_SetFloat(this->dvar, value);
 		}
 	}
@@ -147,6 +151,7 @@ namespace Components
 		assert(this->dvar->type == Game::DVAR_TYPE_BOOL);
 		if (this->dvar)
 		{
+			if (this->dvar->current.enabled != enabled) ++Dvar::ModificationEpoch;
 			Game::Dvar_SetBool(this->dvar, enabled);
 		}
 	}
@@ -208,6 +213,9 @@ namespace Components
 
 	void Dvar::ResetDvarsValue()
 	{
+		// Pending values have to be on disk before the file is executed
+		Persistence::Flush();
+
 		if (!Utils::IO::FileExists(Dvar::ArchiveDvarPath))
 			return;
 
@@ -276,6 +284,7 @@ namespace Components
 		{
 			if (Utils::String::ToLower(dvarName) == Utils::String::ToLower(exceptions[i]))
 			{
+				++Dvar::ModificationEpoch;
 				Game::Dvar_SetFromStringByNameFromSource(dvarName, string, Game::DvarSetSource::DVAR_SOURCE_INTERNAL);
 				return;
 			}
@@ -286,19 +295,20 @@ namespace Components
 
 	void Dvar::SetFromStringByNameExternal(const char* dvarName, const char* string)
 	{
+		++Dvar::ModificationEpoch;
 		Game::Dvar_SetFromStringByNameFromSource(dvarName, string, Game::DvarSetSource::DVAR_SOURCE_EXTERNAL);
 	}
 
-	void Dvar::SaveArchiveDvar(const Game::dvar_t* var)
+	unsigned int Dvar::GetModificationEpoch()
 	{
-		if (!Utils::IO::FileExists(Dvar::ArchiveDvarPath))
-		{
-			Utils::IO::WriteFile(Dvar::ArchiveDvarPath,
-				"// generated by IW4x, do not modify\n");
-		}
+		return Dvar::ModificationEpoch;
+	}
 
-		Utils::IO::WriteFile(Dvar::ArchiveDvarPath,
-			Utils::String::VA("seta %s \"%s\"\n", var->name, Game::Dvar_DisplayableValue(var)), true);
+	void Dvar::SaveArchiveDvar(const Game::dvar_t* var)
+	{
+		Persistence::Append(Dvar::ArchiveDvarPath,
+			Utils::String::VA("seta %s \"%s\"\n", var->name, Game::Dvar_DisplayableValue(var)),
+			"// generated by IW4x, do not modify\n");
 	}
 
 	void Dvar::DvarSetFromStringByNameStub(const char* dvarName, const char* value)
@@ -310,6 +320,7 @@ namespace Components
 			Dvar::SaveArchiveDvar(dvar);
 		}
 
+		++Dvar::ModificationEpoch;
 		Utils::Hook::Call<void(const char*, const char*)>(0x4F52E0)(dvarName, value);
 	}
 
@@ -394,6 +405,8 @@ namespace Components
 	Dvar::~Dvar()
 	{
 		Dvar::RegistrationSignal.clear();
+
+		Persistence::Flush();
 		Utils::IO::RemoveFile(Dvar::ArchiveDvarPath);
 	}
 }
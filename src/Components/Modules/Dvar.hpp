@@ -51,9 +51,13 @@ namespace Components
 
 		static void ResetDvarsValue();
 
+		// Changes whenever a dvar is set through Var or from the console, configs and menus, so callers can cache what they derive from dvars
+		static unsigned int GetModificationEpoch();
+
 	private:
 		static Utils::Signal<Scheduler::Callback> RegistrationSignal;
 		static const char* ArchiveDvarPath;
+		static unsigned int ModificationEpoch;
 
 		static Game::dvar_t* RegisterName(const char* name, const char* defaultVal, Game::dvar_flag flag, const char* description);
 
@@ -539,7 +539,10 @@ namespace Components
 			friendEntry->set_prestige(entry.prestige);
 		}
 
-		Utils::IO::WriteFile("players/friends.dat", list.SerializeAsString());
+		Persistence::Store("players/friends.dat", [list]()
+		{
+			return list.SerializeAsString();
+		});
 	}
 
 	Game::Material* Friends::CreateAvatar(SteamID user)
@@ -2,9 +2,26 @@
 
 namespace Components
 {
+	Logger::Record Logger::Ring[LOGGER_RING_SIZE];
+	std::atomic<size_t> Logger::RingHead;
+	size_t Logger::RingTail = 0;
+	std::atomic<size_t> Logger::RingConsumed;
+
+	std::atomic<unsigned int> Logger::DroppedMessages;
+	std::atomic<unsigned long long> Logger::DroppedBytes;
+	std::atomic<unsigned long long> Logger::WrittenMessages;
+
+	bool Logger::FlushTerminate = false;
+	std::thread Logger::FlushThread;
+	std::mutex Logger::FlushMutex;
+	std::condition_variable Logger::FlushCondition;
+
 	std::mutex Logger::MessageMutex;
-	std::vector<std::string> Logger::MessageQueue;
+	std::string Logger::MessageQueue;
+
+	std::mutex Logger::AddressMutex;
 	std::vector<Network::Address> Logger::LoggingAddresses[2];
+	std::atomic<size_t> Logger::LoggingAddressCount[2];
 	void(*Logger::PipeCallback)(const std::string&) = nullptr;
 
 	bool Logger::IsConsoleReady()
@@ -36,19 +53,23 @@ namespace Components
 			return;
 		}
 
+		uint8_t sinks = 0;
+
 		if (!Logger::IsConsoleReady())
 		{
-			OutputDebugStringA(message.data());
+			sinks |= SINK_DEBUG;
 		}
 
 		if (!Game::Sys_IsMainThread())
 		{
-			Logger::EnqueueMessage(message);
+			sinks |= SINK_CONSOLE;
 		}
 		else
 		{
 			Game::Com_PrintMessage(channel, message.data(), 0);
 		}
+
+		if (sinks) Logger::EnqueueMessage(sinks, message);
 	}
 
 	void Logger::ErrorPrint(Game::errorParm_t error, const std::string& message)
@@ -89,14 +110,19 @@ namespace Components
 
 	void Logger::Flush()
 	{
-// 		if (!Game::Sys_IsMainThread())
-// 		{
-// 			while (!Logger::MessageQueue.empty())
-// 			{
-// 				std::this_thread::sleep_for(10ms);
-// 			}
-// 		}
-// 		else
+		if (Logger::FlushThread.joinable())
+		{
+			const size_t head = Logger::RingHead;
+			Logger::FlushCondition.notify_one();
+
+			// Don't wait forever, a sink might be stuck
+			for (int i = 0; i < 100 && Logger::RingConsumed < head; ++i)
+			{
+				std::this_thread::sleep_for(1ms);
+			}
+		}
+
+		if (Game::Sys_IsMainThread())
 		{
 			Logger::Frame();
 		}
@@ -104,19 +130,217 @@ namespace Components
 
 	void Logger::Frame()
 	{
-		std::lock_guard<std::mutex> _(Logger::MessageMutex);
+		std::string messages;
+
+		{
+			std::lock_guard<std::mutex> _(Logger::MessageMutex);
+			messages.swap(Logger::MessageQueue);
+		}
+
+		if (messages.empty()) return;
+
+		std::vector<std::string> chunks;
+		Logger::SplitChunks(messages, 4095, &chunks);
+
+		for (auto& chunk : chunks)
+		{
+			Game::Com_PrintMessage(0, chunk.data(), 0);
+		}
+	}
+
+	bool Logger::Push(uint8_t sinks, const char* data, size_t length)
+	{
+		length = std::min<size_t>(length, std::min<size_t>(LOGGER_RING_SIZE, 255) * LOGGER_RECORD_SIZE);
+		const auto count = std::max<size_t>(1, (length + LOGGER_RECORD_SIZE - 1) / LOGGER_RECORD_SIZE);
+
+		// Claim all records at once, so concurrent messages can't interleave.
+		// The consumer frees records in order, if the last one is free all others are as well.
+		auto position = Logger::RingHead.load(std::memory_order_relaxed);
+		while (true)
+		{
+			const auto sequence = Logger::Ring[(position + count - 1) % LOGGER_RING_SIZE].sequence.load(std::memory_order_acquire);
+			const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + count - 1);
+
+			if (difference == 0)
+			{
+				if (Logger::RingHead.compare_exchange_weak(position, position + count, std::memory_order_relaxed)) break;
+			}
+			else if (difference < 0)
+			{
+				++Logger::DroppedMessages;
+				Logger::DroppedBytes += length;
+				return false;
+			}
+			else
+			{
+				position = Logger::RingHead.load(std::memory_order_relaxed);
+			}
+		}
+
+		// The first record is published last, once the consumer sees it the whole message is there
+		for (auto i = count; i-- > 0;)
+		{
+			auto& record = Logger::Ring[(position + i) % LOGGER_RING_SIZE];
+
+			const auto offset = i * LOGGER_RECORD_SIZE;
+			record.length = static_cast<uint16_t>(std::min<size_t>(LOGGER_RECORD_SIZE, length - std::min(length, offset)));
+			std::memcpy(record.data, data + offset, record.length);
+
+			record.sinks = sinks;
+			record.count = static_cast<uint8_t>(i ? 0 : count);
+			record.sequence.store(position + i + 1, std::memory_order_release);
+		}
+
+		return true;
+	}
+
+	size_t Logger::Drain(std::string batches[SinkCount])
+	{
+		size_t messages = 0;
+
+		while (true)
+		{
+			auto& first = Logger::Ring[Logger::RingTail % LOGGER_RING_SIZE];
+			if (first.sequence.load(std::memory_order_acquire) != Logger::RingTail + 1) break;
+
+			const size_t count = first.count;
+			const auto sinks = first.sinks;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				auto& record = Logger::Ring[(Logger::RingTail + i) % LOGGER_RING_SIZE];
+
+				for (size_t sink = 0; sink < SinkCount; ++sink)
+				{
+					if (sinks & (1 << sink)) batches[sink].append(record.data, record.length);
+				}
+
+				record.sequence.store(Logger::RingTail + i + LOGGER_RING_SIZE, std::memory_order_release);
+			}
+
+			Logger::RingTail += count;
+			++messages;
+		}
+
+		return messages;
+	}
+
+	void Logger::Write(uint8_t sinks, const std::string& data)
+	{
+		if (Logger::FlushThread.joinable())
+		{
+			Logger::Push(sinks, data.data(), data.size());
+			return;
+		}
+
+		// Without the flush thread, e.g. during shutdown, write right away
+		for (size_t sink = 0; sink < SinkCount; ++sink)
+		{
+			if (sinks & (1 << sink)) Logger::WriteSink(static_cast<Sink>(1 << sink), data);
+		}
+	}
+
+	void Logger::WriteSink(Sink sink, const std::string& data)
+	{
+		switch (sink)
+		{
+		case SINK_CONSOLE:
+		{
+			std::lock_guard<std::mutex> _(Logger::MessageMutex);
+			Logger::MessageQueue.append(data);
+			break;
+		}
+
+		case SINK_DEBUG:
+		{
+			OutputDebugStringA(data.data());
+			break;
+		}
+
+		case SINK_NETWORK:
+		case SINK_GAMELOG:
+		{
+			std::vector<Network::Address> addresses;
+
+			{
+				std::lock_guard<std::mutex> _(Logger::AddressMutex);
+				addresses = Logger::LoggingAddresses[sink == SINK_GAMELOG ? 1 : 0];
+			}
+
+			std::vector<std::string> chunks;
+			Logger::SplitChunks(data, NETWORK_COALESCE_LIMIT, &chunks);
+
+			for (auto& address : addresses)
+			{
+				for (auto& chunk : chunks)
+				{
+					Network::SendCommand(address, "print", chunk);
+				}
+			}
 
-		for (unsigned int i = 0; i < Logger::MessageQueue.size(); ++i)
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	void Logger::SplitChunks(const std::string& data, size_t limit, std::vector<std::string>* chunks)
+	{
+		for (size_t offset = 0; offset < data.size();)
 		{
-			Game::Com_PrintMessage(0, Logger::MessageQueue[i].data(), 0);
+			auto length = std::min(limit, data.size() - offset);
 
-			if (!Logger::IsConsoleReady())
+			if (offset + length < data.size())
 			{
-				OutputDebugStringA(Logger::MessageQueue[i].data());
+				const auto lineEnd = data.rfind('\n', offset + length - 1);
+				if (lineEnd != std::string::npos && lineEnd >= offset) length = lineEnd - offset + 1;
 			}
+
+			chunks->push_back(data.substr(offset, length));
+			offset += length;
 		}
+	}
+
+	void Logger::FlushWorker()
+	{
+		unsigned int reportedDrops = 0;
+
+		while (true)
+		{
+			bool terminate;
 
-		Logger::MessageQueue.clear();
+			{
+				std::unique_lock<std::mutex> lock(Logger::FlushMutex);
+				Logger::FlushCondition.wait_for(lock, LOGGER_FLUSH_INTERVAL, []()
+				{
+					return Logger::FlushTerminate;
+				});
+
+				terminate = Logger::FlushTerminate;
+			}
+
+			// Everything that arrived during the interval is handed to each sink at once
+			std::string batches[SinkCount];
+			Logger::WrittenMessages += Logger::Drain(batches);
+
+			const unsigned int dropped = Logger::DroppedMessages;
+			if (dropped != reportedDrops)
+			{
+				batches[0].append(Utils::String::VA("^3%u log messages dropped, the log ring is full\n", dropped - reportedDrops));
+				reportedDrops = dropped;
+			}
+
+			for (size_t sink = 0; sink < SinkCount; ++sink)
+			{
+				if (!batches[sink].empty()) Logger::WriteSink(static_cast<Sink>(1 << sink), batches[sink]);
+			}
+
+			Logger::RingConsumed = Logger::RingTail;
+
+			if (terminate) return;
+		}
 	}
 
 	void Logger::PipeOutput(void(*callback)(const std::string&))
@@ -134,13 +358,9 @@ namespace Components
 
 	void Logger::NetworkLog(const char* data, bool gLog)
 	{
-		if (!data) return;
+		if (!data || !Logger::LoggingAddressCount[gLog & 1]) return;
 
-		const std::string buffer(data);
-		for (const auto& addr : Logger::LoggingAddresses[gLog & 1])
-		{
-			Network::SendCommand(addr, "print", buffer);
-		}
+		Logger::EnqueueMessage(gLog ? SINK_GAMELOG : SINK_NETWORK, data);
 	}
 
 	__declspec(naked) void Logger::GameLogStub()
@@ -192,11 +412,16 @@ namespace Components
 		}
 	}
 
-	void Logger::EnqueueMessage(const std::string& message)
+	void Logger::EnqueueMessage(uint8_t sinks, const std::string& message)
+	{
+		Logger::Write(sinks, message);
+	}
+
+	void Logger::UpdateAddressCount()
 	{
-		Logger::MessageMutex.lock();
-		Logger::MessageQueue.push_back(message);
-		Logger::MessageMutex.unlock();
+		std::lock_guard<std::mutex> _(Logger::AddressMutex);
+		Logger::LoggingAddressCount[0] = Logger::LoggingAddresses[0].size();
+		Logger::LoggingAddressCount[1] = Logger::LoggingAddresses[1].size();
 	}
 
 	void Logger::RedirectOSPath(const char* file, char* folder)
@@ -238,8 +463,51 @@ namespace Components
 		}
 	}
 
+	bool Logger::unitTest()
+	{
+		printf("Testing log ring...");
+
+		bool success = true;
+		std::string batches[SinkCount];
+
+		// A message spanning several records must arrive in one piece and only at its sinks
+		const std::string longMessage(LOGGER_RECORD_SIZE * 2 + 17, 'x');
+		success &= Logger::Push(SINK_CONSOLE, "first\n", 6);
+		success &= Logger::Push(SINK_CONSOLE | SINK_NETWORK, longMessage.data(), longMessage.size());
+		success &= Logger::Push(SINK_NETWORK, "", 0);
+		success &= Logger::Drain(batches) == 3;
+		success &= batches[0] == "first\n" + longMessage && batches[2] == longMessage && batches[1].empty() && batches[3].empty();
+
+		// Filling the ring drops messages instead of blocking, draining makes room again
+		const unsigned int dropped = Logger::DroppedMessages;
+
+		size_t pushed = 0;
+		while (Logger::Push(SINK_DEBUG, "fill", 4)) ++pushed;
+
+		success &= pushed == LOGGER_RING_SIZE && Logger::DroppedMessages == dropped + 1;
+		success &= !Logger::Push(SINK_DEBUG, longMessage.data(), longMessage.size());
+
+		for (auto& batch : batches) batch.clear();
+		success &= Logger::Drain(batches) == LOGGER_RING_SIZE && batches[1].size() == LOGGER_RING_SIZE * 4;
+		success &= Logger::Push(SINK_DEBUG, longMessage.data(), longMessage.size()) && Logger::Drain(batches) == 1;
+
+		if (success) printf("Success\n");
+		else printf("Error\n");
+
+		return success;
+	}
+
 	Logger::Logger()
 	{
+		for (size_t i = 0; i < LOGGER_RING_SIZE; ++i)
+		{
+			Logger::Ring[i].sequence = i;
+		}
+
+		Logger::RingHead = 0;
+		Logger::RingTail = 0;
+		Logger::RingConsumed = 0;
+
 		Dvar::Register<bool>("iw4x_onelog", false, Game::dvar_flag::DVAR_LATCH | Game::dvar_flag::DVAR_ARCHIVE, "Only write the game log to the 'userraw' OS folder");
 		Utils::Hook(0x642139, Logger::BuildOSPathStub, HOOK_JUMP).install()->quick();
 
@@ -254,121 +522,124 @@ namespace Components
 		{
 			Utils::Hook(Game::Com_Printf, Logger::PrintStub, HOOK_JUMP).install()->quick();
 		}
+		else
+		{
+			Logger::FlushTerminate = false;
+			Logger::FlushThread = std::thread(Logger::FlushWorker);
+		}
+
+		Command::Add("log_stats", [](Command::Params*)
+		{
+			Logger::Print("%llu messages written, %u dropped (%llu bytes)\n", static_cast<unsigned long long>(Logger::WrittenMessages), static_cast<unsigned int>(Logger::DroppedMessages), static_cast<unsigned long long>(Logger::DroppedBytes));
+		});
 
 		Dvar::OnInit([]()
 		{
-			Command::AddSV("log_add", [](Command::Params* params)
+			// The game keeps the name pointers
+			static const char* commands[2][3] =
 			{
-				if (params->size() < 2) return;
-
-				Network::Address addr(params->get(1));
-
-				if (std::find(Logger::LoggingAddresses[0].begin(), Logger::LoggingAddresses[0].end(), addr) == Logger::LoggingAddresses[0].end())
-				{
-					Logger::LoggingAddresses[0].push_back(addr);
-				}
-			});
+				{ "log_add", "log_del", "log_list" },
+				{ "g_log_add", "g_log_del", "g_log_list" },
+			};
 
-			Command::AddSV("log_del", [](Command::Params* params)
+			for (int gLog = 0; gLog < 2; ++gLog)
 			{
-				if (params->size() < 2) return;
-
-				int num = atoi(params->get(1));
-				if (Utils::String::VA("%i", num) == std::string(params->get(1)) && static_cast<unsigned int>(num) < Logger::LoggingAddresses[0].size())
-				{
-					auto addr = Logger::LoggingAddresses[0].begin() + num;
-					Logger::Print("Address %s removed\n", addr->getCString());
-					Logger::LoggingAddresses[0].erase(addr);
-				}
-				else
+				Command::AddSV(commands[gLog][0], [gLog](Command::Params* params)
 				{
+					if (params->size() < 2) return;
+
 					Network::Address addr(params->get(1));
 
-					auto i = std::find(Logger::LoggingAddresses[0].begin(), Logger::LoggingAddresses[0].end(), addr);
-					if (i != Logger::LoggingAddresses[0].end())
 					{
-						Logger::LoggingAddresses[0].erase(i);
-						Logger::Print("Address %s removed\n", addr.getCString());
-					}
-					else
-					{
-						Logger::Print("Address %s not found!\n", addr.getCString());
+						std::lock_guard<std::mutex> _(Logger::AddressMutex);
+						auto& addresses = Logger::LoggingAddresses[gLog];
+
+						if (std::find(addresses.begin(), addresses.end(), addr) == addresses.end())
+						{
+							addresses.push_back(addr);
+						}
 					}
-				}
-			});
 
-			Command::AddSV("log_list", [](Command::Params*)
-			{
-				Logger::Print("# ID: Address\n");
-				Logger::Print("-------------\n");
+					Logger::UpdateAddressCount();
+				});
 
-				for (unsigned int i = 0; i < Logger::LoggingAddresses[0].size(); ++i)
+				Command::AddSV(commands[gLog][1], [gLog](Command::Params* params)
 				{
-					Logger::Print("#%03d: %5s\n", i, Logger::LoggingAddresses[0][i].getCString());
-				}
-			});
-
-			Command::AddSV("g_log_add", [](Command::Params* params)
-			{
-				if (params->size() < 2) return;
-
-				Network::Address addr(params->get(1));
+					if (params->size() < 2) return;
 
-				if (std::find(Logger::LoggingAddresses[1].begin(), Logger::LoggingAddresses[1].end(), addr) == Logger::LoggingAddresses[1].end())
-				{
-					Logger::LoggingAddresses[1].push_back(addr);
-				}
-			});
+					Network::Address addr(params->get(1));
+					bool removed = false;
 
-			Command::AddSV("g_log_del", [](Command::Params* params)
-			{
-				if (params->size() < 2) return;
+					{
+						std::lock_guard<std::mutex> _(Logger::AddressMutex);
+						auto& addresses = Logger::LoggingAddresses[gLog];
+
+						int num = atoi(params->get(1));
+						if (Utils::String::VA("%i", num) == std::string(params->get(1)) && static_cast<unsigned int>(num) < addresses.size())
+						{
+							addr = addresses[num];
+							addresses.erase(addresses.begin() + num);
+							removed = true;
+						}
+						else
+						{
+							auto i = std::find(addresses.begin(), addresses.end(), addr);
+							if (i != addresses.end())
+							{
+								addresses.erase(i);
+								removed = true;
+							}
+						}
+					}
 
-				int num = atoi(params->get(1));
-				if (Utils::String::VA("%i", num) == std::string(params->get(1)) && static_cast<unsigned int>(num) < Logger::LoggingAddresses[1].size())
-				{
-					auto addr = Logger::LoggingAddresses[1].begin() + num;
-					Logger::Print("Address %s removed\n", addr->getCString());
-					Logger::LoggingAddresses[1].erase(addr);
-				}
-				else
-				{
-					Network::Address addr(params->get(1));
+					Logger::UpdateAddressCount();
 
-					auto i = std::find(Logger::LoggingAddresses[1].begin(), Logger::LoggingAddresses[1].end(), addr);
-					if (i != Logger::LoggingAddresses[1].end())
+					// Printing while holding the lock would deadlock once the output is written synchronously
+					if (removed)
 					{
-						Logger::LoggingAddresses[1].erase(i);
 						Logger::Print("Address %s removed\n", addr.getCString());
 					}
 					else
 					{
 						Logger::Print("Address %s not found!\n", addr.getCString());
 					}
-				}
-			});
-
-			Command::AddSV("g_log_list", [](Command::Params*)
-			{
-				Logger::Print("# ID: Address\n");
-				Logger::Print("-------------\n");
+				});
 
-				for (unsigned int i = 0; i < Logger::LoggingAddresses[1].size(); ++i)
+				Command::AddSV(commands[gLog][2], [gLog](Command::Params*)
 				{
-					Logger::Print("#%03d: %5s\n", i, Logger::LoggingAddresses[1][i].getCString());
-				}
-			});
+					std::vector<Network::Address> addresses;
+
+					{
+						std::lock_guard<std::mutex> _(Logger::AddressMutex);
+						addresses = Logger::LoggingAddresses[gLog];
+					}
+
+					Logger::Print("# ID: Address\n");
+					Logger::Print("-------------\n");
+
+					for (unsigned int i = 0; i < addresses.size(); ++i)
+					{
+						Logger::Print("#%03d: %5s\n", i, addresses[i].getCString());
+					}
+				});
+			}
 		});
 	}
 
 	Logger::~Logger()
 	{
-		Logger::LoggingAddresses[0].clear();
-		Logger::LoggingAddresses[1].clear();
+		{
+			std::lock_guard<std::mutex> _(Logger::AddressMutex);
+			Logger::LoggingAddresses[0].clear();
+			Logger::LoggingAddresses[1].clear();
+		}
 
-		Logger::MessageMutex.lock();
-		Logger::MessageQueue.clear();
-		Logger::MessageMutex.unlock();
+		Logger::UpdateAddressCount();
+
+		{
+			std::lock_guard<std::mutex> _(Logger::MessageMutex);
+			Logger::MessageQueue.clear();
+		}
 
 		// Flush the console log
 		if (const auto logfile = *reinterpret_cast<int*>(0x1AD8F28))
@@ -376,4 +647,20 @@ namespace Components
 			Game::FS_FCloseFile(logfile);
 		}
 	}
+
+	void Logger::preDestroy()
+	{
+		{
+			std::lock_guard<std::mutex> _(Logger::FlushMutex);
+			Logger::FlushTerminate = true;
+		}
+
+		Logger::FlushCondition.notify_all();
+
+		// The worker drains the ring before exiting, later messages are written synchronously
+		if (Logger::FlushThread.joinable())
+		{
+			Logger::FlushThread.join();
+		}
+	}
 }
@@ -1,5 +1,12 @@
 #pragma once
 
+// Preallocated records of the log ring, longer messages span several consecutive records
+#define LOGGER_RING_SIZE 4096
+#define LOGGER_RECORD_SIZE 256
+
+// Time the flush thread collects records before handing them to the sinks
+#define LOGGER_FLUSH_INTERVAL 5ms
+
 namespace Components
 {
 	class Logger : public Component
@@ -8,6 +15,9 @@ namespace Components
 		Logger();
 		~Logger();
 
+		void preDestroy() override;
+		bool unitTest() override;
+
 		static void MessagePrint(int channel, const std::string& message);
 		static void Print(int channel, const char* message, ...);
 		static void Print(const char* message, ...);
@@ -24,16 +34,66 @@ namespace Components
 		static void Flush();
 
 	private:
+		enum Sink : uint8_t
+		{
+			SINK_CONSOLE = 1 << 0, // Printed on the main thread
+			SINK_DEBUG = 1 << 1, // OutputDebugString, while the console isn't ready
+			SINK_NETWORK = 1 << 2, // Addresses added by log_add
+			SINK_GAMELOG = 1 << 3, // Addresses added by g_log_add
+		};
+
+		static constexpr size_t SinkCount = 4;
+
+		class Record
+		{
+		public:
+			// Equals the ring position once the record is free, the position + 1 once it is published
+			std::atomic<size_t> sequence;
+
+			uint8_t sinks;
+			uint8_t count; // Records the message spans, only set on the first one
+			uint16_t length;
+			char data[LOGGER_RECORD_SIZE];
+		};
+
+		static Record Ring[LOGGER_RING_SIZE];
+		static std::atomic<size_t> RingHead;
+		static size_t RingTail; // Only accessed by the consumer
+		static std::atomic<size_t> RingConsumed;
+
+		static std::atomic<unsigned int> DroppedMessages;
+		static std::atomic<unsigned long long> DroppedBytes;
+		static std::atomic<unsigned long long> WrittenMessages;
+
+		static bool FlushTerminate;
+		static std::thread FlushThread;
+		static std::mutex FlushMutex;
+		static std::condition_variable FlushCondition;
+
+		// Console output of other threads, printed in Frame
 		static std::mutex MessageMutex;
-		static std::vector<std::string> MessageQueue;
+		static std::string MessageQueue;
+
+		static std::mutex AddressMutex;
 		static std::vector<Network::Address> LoggingAddresses[2];
+		static std::atomic<size_t> LoggingAddressCount[2];
 		static void(*PipeCallback)(const std::string&);
 
+		static bool Push(uint8_t sinks, const char* data, size_t length);
+		static size_t Drain(std::string batches[SinkCount]);
+		static void Write(uint8_t sinks, const std::string& data);
+		static void WriteSink(Sink sink, const std::string& data);
+		static void FlushWorker();
+
+		// Splits at line ends where possible, so receivers don't get broken lines
+		static void SplitChunks(const std::string& data, size_t limit, std::vector<std::string>* chunks);
+
 		static void Frame();
 		static void GameLogStub();
 		static void PrintMessageStub();
 		static void PrintMessagePipe(const char* data);
-		static void EnqueueMessage(const std::string& message);
+		static void EnqueueMessage(uint8_t sinks, const std::string& message);
+		static void UpdateAddressCount();
 
 		static void BuildOSPathStub();
 		static void RedirectOSPath(const char* file, char* folder);
@@ -429,15 +429,22 @@ namespace Components
 		{
 			std::string hash;
 
+			// Shares the cache with the map download manifest, files are only hashed again if their size or modification time changed
+			Utils::HashCache cache(Dvar::Var("fs_basepath").get<std::string>() + "\\usermaps\\" + map);
+
 			for(int i = 0; i < ARRAYSIZE(Maps::UserMapFiles); ++i)
 			{
-				std::string filePath = Utils::String::VA("usermaps/%s/%s%s", map.data(), map.data(), Maps::UserMapFiles[i]);
-				if (Utils::IO::FileExists(filePath))
+				std::string fileHash = cache.get(map + Maps::UserMapFiles[i]);
+
+				// The cache stores hex digests, the usermap hash has always been built from the raw ones
+				for (size_t j = 0; j + 1 < fileHash.size(); j += 2)
 				{
-					hash.append(Utils::Cryptography::SHA256::Compute(Utils::IO::ReadFile(filePath)));
+					hash.push_back(static_cast<char>(strtoul(fileHash.substr(j, 2).data(), nullptr, 16)));
 				}
 			}
 
+			cache.save();
+
 			return Utils::Cryptography::JenkinsOneAtATime::Compute(hash);
 		}
 
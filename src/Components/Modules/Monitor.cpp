@@ -49,9 +49,9 @@ namespace Components
 		int servers = list->size();
 		int players = 0;
 
-		for (unsigned int i = 0; i < list->size(); ++i)
+		for (auto& server : *list)
 		{
-			players += list->at(i).clients;
+			players += server.clients;
 		}
 
 		printf("0 IW4x player=%d|server=%d Servers successfully parsed\n", players, servers);
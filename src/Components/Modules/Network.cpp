@@ -2,9 +2,33 @@
 
 namespace Components
 {
-	std::string Network::SelectedPacket;
+	Dvar::Var Network::RemoteSendRate;
+	Dvar::Var Network::RemoteSendBandwidth;
+	Dvar::Var Network::BroadcastSendRate;
+	Dvar::Var Network::BroadcastSendBandwidth;
+
+	thread_local bool Network::RepliesSuppressed = false;
+
+	std::atomic<bool> Network::SendQueueEnabled;
+	std::mutex Network::SendMutex;
+
+	Network::SendQueue Network::SendQueues[static_cast<size_t>(Network::SendClass::Count)];
+	std::unordered_map<uint64_t, std::shared_ptr<Network::OutgoingPacket>> Network::PendingPrints;
+
+	Dvar::Var Network::SourceRateLimit;
+	Dvar::Var Network::SourceRateBurst;
+	Dvar::Var Network::CommandRateLimit;
+	Dvar::Var Network::PacketCosts;
+
+	std::unique_ptr<Network::SourceSet[]> Network::SourceTable;
+
+	Network::PacketHandler* Network::SelectedPacket;
+	unsigned long long Network::UnhandledPackets;
+	unsigned long long Network::DroppedPackets;
+	unsigned long long Network::SourceDroppedPackets;
+	unsigned long long Network::SourceEvictions;
 	Utils::Signal<Network::CallbackRaw> Network::StartupSignal;
-	std::map<std::string, Utils::Slot<Network::Callback>> Network::PacketHandlers;
+	std::unordered_map<std::string_view, std::unique_ptr<Network::PacketHandler>> Network::PacketHandlers;
 
 	Network::Address::Address(const std::string& addrString)
 	{
@@ -21,6 +45,31 @@ namespace Components
 		return Game::NET_CompareAdr(this->address, obj.address);
 	}
 
+	uint64_t Network::Address::getKey() const
+	{
+		uint64_t key = static_cast<uint64_t>(this->address.type) << 48;
+
+		if (this->address.type == Game::netadrtype_t::NA_IP || this->address.type == Game::netadrtype_t::NA_BROADCAST)
+		{
+			key |= static_cast<uint64_t>(this->address.port) << 32;
+			key |= this->address.ip.full;
+		}
+
+		return key;
+	}
+
+	size_t Network::Address::Hash(uint64_t key)
+	{
+		// splitmix64 finalizer, spreads the port and the upper IP bytes into the low bits
+		key ^= key >> 30;
+		key *= 0xBF58476D1CE4E5B9ull;
+		key ^= key >> 27;
+		key *= 0x94D049BB133111EBull;
+		key ^= key >> 31;
+
+		return static_cast<size_t>(key);
+	}
+
 	void Network::Address::setPort(unsigned short port)
 	{
 		this->address.port = htons(port);
@@ -145,7 +194,17 @@ namespace Components
 
 	void Network::Handle(const std::string& packet, Utils::Slot<Network::Callback> callback)
 	{
-		Network::PacketHandlers[Utils::String::ToLower(packet)] = callback;
+		std::string name = Utils::String::ToLower(packet);
+
+		auto handler = Network::PacketHandlers.find(name);
+		if (handler == Network::PacketHandlers.end())
+		{
+			auto entry = std::make_unique<PacketHandler>(name);
+			std::string_view key = entry->name;
+			handler = Network::PacketHandlers.emplace(key, std::move(entry)).first;
+		}
+
+		handler->second->callback = callback;
 	}
 
 	void Network::OnStart(Utils::Slot<Network::CallbackRaw> callback)
@@ -173,13 +232,150 @@ namespace Components
 
 	void Network::SendRaw(Game::netsrc_t type, Network::Address target, const std::string& data)
 	{
-		if (!target.isValid()) return;
+		if (!target.isValid() || (Network::RepliesSuppressed && target.getType() == Game::netadrtype_t::NA_LOOPBACK)) return;
+
+		if (Network::Enqueue(type, target, data)) return;
 
 		// NET_OutOfBandData doesn't seem to work properly
 		//Game::NET_OutOfBandData(type, *target.Get(), data.data(), data.size());
 		Game::Sys_SendPacket(type, data.size(), data.data(), *target.get());
 	}
 
+	Network::SendClass Network::GetSendClass(Address& target)
+	{
+		if (target.getType() == Game::netadrtype_t::NA_BROADCAST) return SendClass::Broadcast;
+		if (target.getType() != Game::netadrtype_t::NA_IP || target.isLoopback() || target.isLocal()) return SendClass::Local;
+		return SendClass::Remote;
+	}
+
+	uint64_t Network::GetPrintKey(Game::netsrc_t type, Address& target)
+	{
+		// The address key leaves the top byte unused
+		return target.getKey() | (static_cast<uint64_t>(type) << 56);
+	}
+
+	bool Network::Enqueue(Game::netsrc_t type, Address& target, const std::string& data)
+	{
+		// Loopback packets never hit the wire, unit tests and shutdown send directly
+		if (!Network::SendQueueEnabled || target.getType() == Game::netadrtype_t::NA_LOOPBACK || target.getType() == Game::netadrtype_t::NA_BOT) return false;
+
+		static const std::string printHeader("\xFF\xFF\xFF\xFFprint\n", 10);
+		const auto isPrint = data.compare(0, printHeader.size(), printHeader) == 0;
+
+		{
+			std::lock_guard<std::mutex> _(Network::SendMutex);
+			auto& queue = Network::SendQueues[static_cast<size_t>(Network::GetSendClass(target))];
+
+			// Consecutive prints to the same target are plain text, append them to the pending datagram
+			if (isPrint)
+			{
+				auto pending = Network::PendingPrints.find(Network::GetPrintKey(type, target));
+				if (pending != Network::PendingPrints.end() && pending->second->data.size() + data.size() - printHeader.size() <= NETWORK_COALESCE_LIMIT)
+				{
+					pending->second->data.append(data, printHeader.size(), std::string::npos);
+					++queue.coalesced;
+					return true;
+				}
+			}
+
+			if (queue.packets.size() >= NETWORK_SEND_QUEUE_LIMIT)
+			{
+				++queue.dropped;
+				return true;
+			}
+
+			auto packet = std::make_shared<OutgoingPacket>();
+			packet->type = type;
+			packet->target = target;
+			packet->data = data;
+
+			queue.packets.push_back(packet);
+			queue.peak = std::max(queue.peak, queue.packets.size());
+
+			if (isPrint) Network::PendingPrints[Network::GetPrintKey(type, target)] = packet;
+		}
+
+		return true;
+	}
+
+	bool Network::DrainQueue(SendClass sendClass, std::unique_lock<std::mutex>& lock)
+	{
+		auto& queue = Network::SendQueues[static_cast<size_t>(sendClass)];
+
+		float packetRate = 0.0f;
+		float byteRate = 0.0f;
+
+		if (sendClass == SendClass::Remote)
+		{
+			packetRate = Network::RemoteSendRate.get<float>();
+			byteRate = Network::RemoteSendBandwidth.get<float>();
+		}
+		else if (sendClass == SendClass::Broadcast)
+		{
+			packetRate = Network::BroadcastSendRate.get<float>();
+			byteRate = Network::BroadcastSendBandwidth.get<float>();
+		}
+
+		// Queues are drained once per frame, so allow bursts of 100ms worth of traffic, oversized packets are charged a full burst
+		const auto packetBurst = std::max(1.0f, packetRate / 10.0f);
+		const auto byteBurst = std::max(2048.0f, byteRate / 10.0f);
+
+		if (packetRate > 0.0f) queue.packetBucket.refill(packetRate, packetBurst);
+		if (byteRate > 0.0f) queue.byteBucket.refill(byteRate, byteBurst);
+
+		while (!queue.packets.empty())
+		{
+			auto packet = queue.packets.front();
+			const auto cost = std::min(static_cast<double>(packet->data.size()), static_cast<double>(byteBurst));
+
+			// Replies that waited this long are useless to the receiver, which has timed out or asked again
+			const auto expired = packet->queued.elapsed(NETWORK_SEND_MAX_AGE);
+
+			if (!expired)
+			{
+				if (packetRate > 0.0f && queue.packetBucket.available() < 1.0) return false;
+				if (byteRate > 0.0f && queue.byteBucket.available() < cost) return false;
+
+				if (packetRate > 0.0f) queue.packetBucket.consume(1.0);
+				if (byteRate > 0.0f) queue.byteBucket.consume(cost);
+			}
+
+			queue.packets.pop_front();
+
+			const auto pending = Network::PendingPrints.find(Network::GetPrintKey(packet->type, packet->target));
+			if (pending != Network::PendingPrints.end() && pending->second == packet)
+			{
+				Network::PendingPrints.erase(pending);
+			}
+
+			if (expired)
+			{
+				++queue.expired;
+				continue;
+			}
+
+			++queue.sent;
+
+			// Other threads keep queueing while we're sending
+			lock.unlock();
+			Game::Sys_SendPacket(packet->type, packet->data.size(), packet->data.data(), *packet->target.get());
+			lock.lock();
+		}
+
+		return true;
+	}
+
+	void Network::DrainQueues()
+	{
+		std::unique_lock<std::mutex> lock(Network::SendMutex);
+
+		// Whatever is still short on tokens waits for the next frame
+		for (size_t i = 0; i < static_cast<size_t>(SendClass::Count); ++i)
+		{
+			Network::DrainQueue(static_cast<SendClass>(i), lock);
+		}
+	}
+
 	void Network::SendRaw(Network::Address target, const std::string& data)
 	{
 		Network::SendRaw(Game::netsrc_t::NS_CLIENT1, target, data);
@@ -229,51 +425,69 @@ namespace Components
 
 	int Network::PacketInterceptionHandler(const char* packet)
 	{
-		// Packet rate limit.
-		static uint32_t packets = 0;
-		static int lastClean = 0;
-
-		if ((Game::Sys_Milliseconds() - lastClean) > 1'000)
+		auto* handler = Network::FindHandler(packet, std::numeric_limits<size_t>::max());
+		if (handler)
 		{
-			packets = 0;
-			lastClean = Game::Sys_Milliseconds();
+			Network::SelectedPacket = handler;
+			return 0;
 		}
 
-		if ((++packets) > NETWORK_MAX_PACKETS_PER_SECOND)
-		{
-			return 1;
-		}
+		// No interception
+		++Network::UnhandledPackets;
+		return 1;
+	}
+
+	Network::PacketHandler* Network::FindHandler(const char* packet, size_t size)
+	{
+		// Lowercase the command into a local buffer, handlers are registered with lowercase names
+		char command[NETWORK_MAX_COMMAND_LENGTH];
+		size_t length = 0;
 
-		std::string packetCommand = packet;
-		auto pos = packetCommand.find_first_of("\\\n ");
-		if (pos != std::string::npos)
+		for (; length < size && packet[length] && !strchr("\\\n ", packet[length]); ++length)
 		{
-			packetCommand = packetCommand.substr(0, pos);
+			if (length >= sizeof(command)) return nullptr;
+
+			command[length] = static_cast<char>(tolower(static_cast<unsigned char>(packet[length])));
 		}
 
-		packetCommand = Utils::String::ToLower(packetCommand);
+		auto handler = Network::PacketHandlers.find(std::string_view(command, length));
+		if (handler == Network::PacketHandlers.end()) return nullptr;
+
+		return handler->second.get();
+	}
+
+	bool Network::Dispatch(Address address, const std::string& packet, std::string* command)
+	{
+		auto* handler = Network::FindHandler(packet.data(), packet.size());
+		if (!handler) return false;
+
+		if (command) *command = handler->name;
 
-		// Check if custom handler exists
-		for (auto i = Network::PacketHandlers.begin(); i != Network::PacketHandlers.end(); ++i)
+		std::string data;
+		if (packet.size() > handler->name.size() + 1)
 		{
-			if (Utils::String::ToLower(i->first) == packetCommand)
-			{
-				Network::SelectedPacket = i->first;
-				return 0;
-			}
+			data = packet.substr(handler->name.size() + 1);
 		}
 
-		// No interception
-		return 1;
+		handler->callback(address, data);
+		return true;
+	}
+
+	void Network::SuppressReplies(bool suppress)
+	{
+		Network::RepliesSuppressed = suppress;
 	}
 
 	void Network::DeployPacket(Game::netadr_t* from, Game::msg_t* msg)
 	{
-		if (Network::PacketHandlers.find(Network::SelectedPacket) != Network::PacketHandlers.end())
+		auto* handler = Network::SelectedPacket;
+		Network::SelectedPacket = nullptr;
+
+		if (handler)
 		{
 			std::string data;
 
-			size_t offset = Network::SelectedPacket.size() + 4 + 1;
+			size_t offset = handler->name.size() + 4 + 1;
 
 			if (static_cast<size_t>(msg->cursize) > offset)
 			{
@@ -284,7 +498,50 @@ namespace Components
 			// Actually, don't remove it, it might be part of the packet. Send correctly formatted packets instead!
 			//if (data.size() && !data[data.size() - 1]) data.pop_back();
 
-			Network::PacketHandlers[Network::SelectedPacket](from, data);
+			PacketCapture::Record(from, msg, handler->name);
+
+			// Checked before the global limit, so a single source can't use up the budget of everyone else
+			auto* source = Network::UpdateSource(from, handler->cost);
+			if (source && source->tokens < handler->cost)
+			{
+				++source->dropped;
+				++Network::SourceDroppedPackets;
+				++handler->dropped;
+				return;
+			}
+
+			// Packet rate limit.
+			static uint32_t packets = 0;
+			static int lastClean = 0;
+
+			if ((Game::Sys_Milliseconds() - lastClean) > 1'000)
+			{
+				packets = 0;
+				lastClean = Game::Sys_Milliseconds();
+			}
+
+			if ((++packets) > NETWORK_MAX_PACKETS_PER_SECOND)
+			{
+				++Network::DroppedPackets;
+				++handler->dropped;
+				return;
+			}
+
+			if (!Network::ConsumeCommand(handler))
+			{
+				++handler->dropped;
+				return;
+			}
+
+			// Only accepted packets are charged to their source
+			if (source) source->tokens -= handler->cost;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			handler->callback(from, data);
+
+			++handler->packets;
+			handler->bytes += std::max(msg->cursize, 0);
+			handler->time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
 		}
 		else
 		{
@@ -292,6 +549,169 @@ namespace Components
 		}
 	}
 
+	Network::SourceEntry* Network::UpdateSource(Game::netadr_t* from, unsigned int cost)
+	{
+		Address source(from);
+
+		const auto rate = Network::SourceRateLimit.get<float>();
+		if (rate <= 0.0f || source.isLoopback() || !Network::SourceTable) return nullptr;
+
+		const auto burst = std::max(Network::SourceRateBurst.get<float>(), static_cast<float>(cost));
+		const auto now = Game::Sys_Milliseconds();
+		const auto ip = source.getIP().full;
+
+		// Fibonacci hashing, the table size is a power of two
+		auto& set = Network::SourceTable[((ip * 2654435761u) >> 16) % NETWORK_RATE_LIMIT_SETS];
+
+		SourceEntry* entry = nullptr;
+		SourceEntry* oldest = &set.entries[0];
+
+		for (auto& candidate : set.entries)
+		{
+			if (candidate.ip == ip)
+			{
+				entry = &candidate;
+				break;
+			}
+
+			if ((now - candidate.lastUpdate) > (now - oldest->lastUpdate))
+			{
+				oldest = &candidate;
+			}
+		}
+
+		if (!entry)
+		{
+			// Evict the least recently seen source of this set
+			if (oldest->lastUpdate) ++Network::SourceEvictions;
+
+			entry = oldest;
+			entry->ip = ip;
+			entry->tokens = burst;
+			entry->lastUpdate = now;
+			entry->dropped = 0;
+		}
+		else
+		{
+			entry->tokens = std::min(burst, entry->tokens + (now - entry->lastUpdate) * rate / 1000.0f);
+			entry->lastUpdate = now;
+		}
+
+		return entry;
+	}
+
+	bool Network::ConsumeCommand(PacketHandler* handler)
+	{
+		const auto rate = Network::CommandRateLimit.get<int>();
+		if (rate <= 0) return true;
+
+		// Allow one second worth of burst
+		handler->bucket.refill(rate, rate);
+		return handler->bucket.consume(handler->cost);
+	}
+
+	void Network::ApplyPacketCosts()
+	{
+		for (auto& handler : Network::PacketHandlers)
+		{
+			handler.second->cost = 1;
+		}
+
+		// Format: "<command>:<cost> <command>:<cost> ..."
+		for (auto& entry : Utils::String::Split(Network::PacketCosts.get<std::string>(), ' '))
+		{
+			const auto separator = entry.find(':');
+			if (separator == std::string::npos) continue;
+
+			const auto handler = Network::PacketHandlers.find(Utils::String::ToLower(entry.substr(0, separator)));
+			if (handler == Network::PacketHandlers.end()) continue;
+
+			handler->second->cost = std::max(1, atoi(entry.data() + separator + 1));
+		}
+	}
+
+	void Network::PrintPacketStats(Command::Params* params)
+	{
+		if (params->size() > 1 && params->get(1) == "reset"s)
+		{
+			for (auto& handler : Network::PacketHandlers)
+			{
+				handler.second->packets = 0;
+				handler.second->bytes = 0;
+				handler.second->time = 0;
+				handler.second->dropped = 0;
+			}
+
+			Network::UnhandledPackets = 0;
+			Network::DroppedPackets = 0;
+			Network::SourceDroppedPackets = 0;
+			Network::SourceEvictions = 0;
+
+			std::lock_guard<std::mutex> _(Network::SendMutex);
+			for (auto& queue : Network::SendQueues)
+			{
+				queue.sent = 0;
+				queue.coalesced = 0;
+				queue.dropped = 0;
+				queue.expired = 0;
+				queue.peak = queue.packets.size();
+			}
+			return;
+		}
+
+		std::vector<PacketHandler*> handlers;
+		for (auto& handler : Network::PacketHandlers)
+		{
+			handlers.push_back(handler.second.get());
+		}
+
+		std::sort(handlers.begin(), handlers.end(), [](PacketHandler* a, PacketHandler* b)
+		{
+			return a->time > b->time;
+		});
+
+		Logger::Print("%-24s %5s %12s %14s %12s %10s %10s\n", "command", "cost", "packets", "bytes", "time (ms)", "avg (us)", "dropped");
+
+		for (auto* handler : handlers)
+		{
+			if (!handler->packets && !handler->dropped) continue;
+
+			Logger::Print("%-24s %5u %12llu %14llu %12llu %10llu %10llu\n", handler->name.data(), handler->cost, handler->packets, handler->bytes,
+				handler->time / 1000, handler->packets ? handler->time / handler->packets : 0, handler->dropped);
+		}
+
+		Logger::Print("Unhandled: %llu, dropped by rate limit: %llu, dropped by source limit: %llu, sources evicted: %llu\n",
+			Network::UnhandledPackets, Network::DroppedPackets, Network::SourceDroppedPackets, Network::SourceEvictions);
+
+		static const char* classNames[] = { "local", "remote", "broadcast" };
+		for (size_t i = 0; i < static_cast<size_t>(SendClass::Count); ++i)
+		{
+			// Printing may log to the network, which queues packets itself
+			std::unique_lock<std::mutex> lock(Network::SendMutex);
+			auto& queue = Network::SendQueues[i];
+			std::string message = Utils::String::VA("Send queue %-10s depth: %u, peak: %u, sent: %llu, coalesced: %llu, dropped: %llu, expired: %llu\n", classNames[i],
+				queue.packets.size(), queue.peak, queue.sent, queue.coalesced, queue.dropped, queue.expired);
+			lock.unlock();
+
+			Logger::Print("%s", message.data());
+		}
+
+		if (params->size() > 1 && params->get(1) == "sources"s && Network::SourceTable)
+		{
+			for (size_t i = 0; i < NETWORK_RATE_LIMIT_SETS; ++i)
+			{
+				for (auto& entry : Network::SourceTable[i].entries)
+				{
+					if (!entry.dropped) continue;
+
+					Game::netIP_t ip;
+					ip.full = entry.ip;
+					Logger::Print("%u.%u.%u.%u: %u dropped\n", ip.bytes[0], ip.bytes[1], ip.bytes[2], ip.bytes[3], entry.dropped);
+				}
+			}
+		}
+	}
+
 	void Network::NetworkStart()
 	{
 		Network::StartupSignal();
@@ -376,6 +796,132 @@ namespace Components
 		Utils::Hook::Call<void(Game::client_t*, Game::msg_t*)>(0x414D40)(client, msg);
 	}
 
+	bool Network::unitTest()
+	{
+		printf("Testing address map...");
+
+		std::vector<Address> addresses;
+		for (unsigned int i = 0; i < 100'000; ++i)
+		{
+			Address address;
+			address.setType(Game::netadrtype_t::NA_IP);
+			address.setIP(static_cast<DWORD>(Utils::Cryptography::Rand::GenerateInt()));
+			address.setPort(static_cast<unsigned short>(28960 + (i % 16)));
+			addresses.push_back(address);
+		}
+
+		AddressMap<unsigned int> map;
+		std::unordered_map<Address, unsigned int> reference;
+
+		for (unsigned int i = 0; i < addresses.size(); ++i)
+		{
+			map[addresses[i]] = i;
+			reference[addresses[i]] = i;
+		}
+
+		// Erase every third address, half of them while iterating
+		for (unsigned int i = 0; i < addresses.size(); i += 6)
+		{
+			map.erase(addresses[i]);
+			reference.erase(addresses[i]);
+		}
+
+		for (auto i = map.begin(); i != map.end();)
+		{
+			if (i->second % 6 == 3)
+			{
+				reference.erase(i->first);
+				i = map.erase(i);
+			}
+			else ++i;
+		}
+
+		if (map.size() != reference.size())
+		{
+			printf("Error\n");
+			printf("Address map holds %u entries, expected %u!\n", map.size(), reference.size());
+			return false;
+		}
+
+		for (auto& entry : reference)
+		{
+			auto i = map.find(entry.first);
+			if (i == map.end() || i->second != entry.second)
+			{
+				printf("Error\n");
+				printf("Address %s is missing or has the wrong value!\n", entry.first.getCString());
+				return false;
+			}
+		}
+
+		printf("Success\n");
+
+		class StringHash
+		{
+		public:
+			size_t operator()(const Address& address) const
+			{
+				return std::hash<std::string>()(address.getString());
+			}
+		};
+
+		auto measure = [](const std::function<void()>& callback)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			callback();
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - startTime).count();
+		};
+
+		for (size_t peers : { 10'000u, 100'000u })
+		{
+			printf("Benchmarking %u peers (insert + lookup, microseconds):\n", peers);
+
+			size_t found = 0;
+
+			std::unordered_map<Address, unsigned int, StringHash> stringMap;
+			auto stringTime = measure([&]()
+			{
+				for (size_t i = 0; i < peers; ++i) stringMap[addresses[i]] = i;
+				for (size_t i = 0; i < peers; ++i) found += stringMap.count(addresses[i]);
+			});
+
+			std::unordered_map<Address, unsigned int> hashMap;
+			auto hashTime = measure([&]()
+			{
+				for (size_t i = 0; i < peers; ++i) hashMap[addresses[i]] = i;
+				for (size_t i = 0; i < peers; ++i) found += hashMap.count(addresses[i]);
+			});
+
+			AddressMap<unsigned int> addressMap;
+			auto addressTime = measure([&]()
+			{
+				for (size_t i = 0; i < peers; ++i) addressMap[addresses[i]] = i;
+				for (size_t i = 0; i < peers; ++i) found += addressMap.contains(addresses[i]);
+			});
+
+			// A full scan per lookup is quadratic, only sample 1000 lookups
+			std::vector<Address> list(addresses.begin(), addresses.begin() + peers);
+			auto scanTime = measure([&]()
+			{
+				for (size_t i = 0; i < 1000; ++i) found += std::find(list.begin(), list.end(), addresses[(i * peers) / 1000]) != list.end();
+			});
+
+			printf("  unordered_map (string hash): %lli\n", stringTime);
+			printf("  unordered_map (key hash):    %lli\n", hashTime);
+			printf("  AddressMap:                  %lli\n", addressTime);
+			printf("  vector scan (1000 lookups):  %lli\n", scanTime);
+
+			if (found != peers * 3 + 1000)
+			{
+				printf("Error\n");
+				printf("Lookups found %u addresses, expected %u!\n", found, peers * 3 + 1000);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
 	Network::Network()
 	{
 		AssertSize(Game::netadr_t, 20);
@@ -422,5 +968,47 @@ namespace Components
 		{
 			Network::SendRaw(address, address.getString());
 		});
+
+		Command::Add("net_packetStats", Network::PrintPacketStats);
+
+		Network::SourceTable = std::make_unique<SourceSet[]>(NETWORK_RATE_LIMIT_SETS);
+		std::memset(Network::SourceTable.get(), 0, sizeof(SourceSet) * NETWORK_RATE_LIMIT_SETS);
+
+		Dvar::OnInit([]()
+		{
+			Network::SourceRateLimit = Dvar::Register<float>("net_sourceRateLimit", 40.0f, 0.0f, 100000.0f, Game::dvar_flag::DVAR_NONE, "Packet cost a single address may spend per second on out-of-band commands, 0 disables the limit");
+			Network::SourceRateBurst = Dvar::Register<float>("net_sourceRateBurst", 80.0f, 1.0f, 100000.0f, Game::dvar_flag::DVAR_NONE, "Packet cost a single address may spend at once");
+			Network::CommandRateLimit = Dvar::Register<int>("net_commandRateLimit", 5000, 0, 1000000, Game::dvar_flag::DVAR_NONE, "Packet cost a single out-of-band command may consume per second across all addresses, 0 disables the limit");
+			Network::PacketCosts = Dvar::Register<const char*>("net_packetCosts", "getStatus:4 rcon:8 rconRequest:4 getPlaylist:8 sessionSyn:2", Game::dvar_flag::DVAR_NONE, "Rate limiter cost of out-of-band commands, as <command>:<cost> pairs");
+
+			Network::ApplyPacketCosts();
+
+			Network::RemoteSendRate = Dvar::Register<float>("net_sendRate", 5000.0f, 0.0f, 1000000.0f, Game::dvar_flag::DVAR_NONE, "Out-of-band packets per second sent to internet addresses, 0 disables pacing");
+			Network::RemoteSendBandwidth = Dvar::Register<float>("net_sendBandwidth", 2000000.0f, 0.0f, 100000000.0f, Game::dvar_flag::DVAR_NONE, "Out-of-band bytes per second sent to internet addresses, 0 disables pacing");
+			Network::BroadcastSendRate = Dvar::Register<float>("net_broadcastRate", 5000.0f, 0.0f, 1000000.0f, Game::dvar_flag::DVAR_NONE, "Broadcast packets per second, 0 disables pacing");
+			Network::BroadcastSendBandwidth = Dvar::Register<float>("net_broadcastBandwidth", 500000.0f, 0.0f, 100000000.0f, Game::dvar_flag::DVAR_NONE, "Broadcast bytes per second, 0 disables pacing");
+		});
+
+		// Queued packets go out once per frame, each class is paced by its own buckets
+		Network::SendQueueEnabled = !Loader::IsPerformingUnitTests();
+
+		Scheduler::OnFrame([]()
+		{
+			Network::DrainQueues();
+
+			auto* costs = Network::PacketCosts.get<Game::dvar_t*>();
+			if (costs && costs->modified)
+			{
+				costs->modified = false;
+				Network::ApplyPacketCosts();
+			}
+		});
+	}
+
+	void Network::preDestroy()
+	{
+		// Send what the buckets allow, everything after this bypasses the queues
+		Network::DrainQueues();
+		Network::SendQueueEnabled = false;
 	}
 }
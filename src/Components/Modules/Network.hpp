@@ -1,6 +1,16 @@
 #pragma once
 
 #define NETWORK_MAX_PACKETS_PER_SECOND 100'000
+#define NETWORK_MAX_COMMAND_LENGTH 64
+
+// Outbound queue, packets beyond the limit are dropped, as are packets queued for longer than the max age (ms)
+#define NETWORK_SEND_QUEUE_LIMIT 131'072
+#define NETWORK_SEND_MAX_AGE 2'000
+#define NETWORK_COALESCE_LIMIT 1'200
+
+// Per-source limiter table, sets * ways sources are tracked at once
+#define NETWORK_RATE_LIMIT_SETS 4096
+#define NETWORK_RATE_LIMIT_WAYS 4
 
 namespace Components
 {
@@ -22,6 +32,11 @@ namespace Components
 			bool operator!=(const Address &obj) const { return !(*this == obj); };
 			bool operator==(const Address &obj) const;
 
+			// Packs type, port and IP into a single integer for AddressMap and hashing.
+			// Port and IP are ignored for non-IP types, so use operator== to compare addresses.
+			uint64_t getKey() const;
+			static size_t Hash(uint64_t key);
+
 			void setPort(unsigned short port);
 			unsigned short getPort();
 
@@ -53,6 +68,9 @@ namespace Components
 
 		Network();
 
+		bool unitTest() override;
+		void preDestroy() override;
+
 		static unsigned short GetPort();
 
 		static void Handle(const std::string& packet, Utils::Slot<Callback> callback);
@@ -70,19 +88,134 @@ namespace Components
 		static void SendCommand(Address target, const std::string& command, const std::string& data = "");
 		static void SendCommand(Game::netsrc_t type, Address target, const std::string& command, const std::string& data = "");
 
+		// Runs the handler registered for a packet without the OOB header, returns false if there is none
+		static bool Dispatch(Address address, const std::string& packet, std::string* command = nullptr);
+
+		// Discards packets the calling thread sends to loopback, so handlers don't answer replayed captures
+		static void SuppressReplies(bool suppress);
+
 		static void Broadcast(unsigned short port, const std::string& data);
 		static void BroadcastRange(unsigned int min, unsigned int max, const std::string& data);
 		static void BroadcastAll(const std::string& data);
 
 	private:
-		static std::string SelectedPacket;
+		class PacketHandler
+		{
+		public:
+			PacketHandler(const std::string& _name) : name(_name), cost(1), packets(0), bytes(0), time(0), dropped(0) {}
+
+			std::string name;
+			Utils::Slot<Callback> callback;
+
+			// Tokens charged to the source and to the command bucket, see net_packetCosts
+			unsigned int cost;
+			Utils::TokenBucket bucket;
+
+			unsigned long long packets;
+			unsigned long long bytes;
+			unsigned long long time; // Microseconds spent in the callback
+			unsigned long long dropped;
+		};
+
+		// 16 bytes, so one set of four fills exactly one cache line
+		class SourceEntry
+		{
+		public:
+			uint32_t ip;
+			float tokens;
+			int lastUpdate;
+			unsigned int dropped;
+		};
+
+		class alignas(64) SourceSet
+		{
+		public:
+			SourceEntry entries[NETWORK_RATE_LIMIT_WAYS];
+		};
+
+		enum class SendClass
+		{
+			Local,
+			Remote,
+			Broadcast,
+
+			Count
+		};
+
+		class OutgoingPacket
+		{
+		public:
+			Game::netsrc_t type;
+			Address target;
+			std::string data;
+			Utils::Time::Point queued;
+		};
+
+		class SendQueue
+		{
+		public:
+			SendQueue() : sent(0), coalesced(0), dropped(0), expired(0), peak(0) {}
+
+			std::deque<std::shared_ptr<OutgoingPacket>> packets;
+			Utils::TokenBucket packetBucket;
+			Utils::TokenBucket byteBucket;
+
+			unsigned long long sent;
+			unsigned long long coalesced;
+			unsigned long long dropped;
+			unsigned long long expired;
+			size_t peak;
+		};
+
+		static Dvar::Var RemoteSendRate;
+		static Dvar::Var RemoteSendBandwidth;
+		static Dvar::Var BroadcastSendRate;
+		static Dvar::Var BroadcastSendBandwidth;
+
+		static thread_local bool RepliesSuppressed;
+
+		static std::atomic<bool> SendQueueEnabled;
+		static std::mutex SendMutex;
+
+		// Guarded by SendMutex
+		static SendQueue SendQueues[static_cast<size_t>(SendClass::Count)];
+		static std::unordered_map<uint64_t, std::shared_ptr<OutgoingPacket>> PendingPrints;
+
+		static Dvar::Var SourceRateLimit;
+		static Dvar::Var SourceRateBurst;
+		static Dvar::Var CommandRateLimit;
+		static Dvar::Var PacketCosts;
+
+		static std::unique_ptr<SourceSet[]> SourceTable;
+
+		static PacketHandler* SelectedPacket;
+		static unsigned long long UnhandledPackets;
+		static unsigned long long DroppedPackets;
+		static unsigned long long SourceDroppedPackets;
+		static unsigned long long SourceEvictions;
 		static Utils::Signal<CallbackRaw> StartupSignal;
-		static std::map<std::string, Utils::Slot<Callback>> PacketHandlers;
 
+		// Keyed by the lowercase command, the views point into the handler's name
+		static std::unordered_map<std::string_view, std::unique_ptr<PacketHandler>> PacketHandlers;
+
+		static PacketHandler* FindHandler(const char* packet, size_t size);
 		static int PacketInterceptionHandler(const char* packet);
 		static void DeployPacket(Game::netadr_t* from, Game::msg_t* msg);
 		static void DeployPacketStub();
 
+		static SendClass GetSendClass(Address& target);
+		static bool Enqueue(Game::netsrc_t type, Address& target, const std::string& data);
+		static uint64_t GetPrintKey(Game::netsrc_t type, Address& target);
+		static bool DrainQueue(SendClass sendClass, std::unique_lock<std::mutex>& lock);
+		static void DrainQueues();
+
+		// Refills the bucket of the source, nullptr if it isn't limited
+		static SourceEntry* UpdateSource(Game::netadr_t* from, unsigned int cost);
+		static bool ConsumeCommand(PacketHandler* handler);
+		static void ApplyPacketCosts();
+
+		static void PrintPacketStats(Command::Params* params);
+
 		static void NetworkStart();
 		static void NetworkStartStub();
 
@@ -98,6 +231,6 @@ struct std::hash<Components::Network::Address>
 {
 	std::size_t operator()(const Components::Network::Address& k) const
 	{
-		return (std::hash<std::string>()(k.getString()));
+		return Components::Network::Address::Hash(k.getKey());
 	}
 };
@@ -3,10 +3,14 @@
 namespace Components
 {
 	std::recursive_mutex Node::Mutex;
-	std::vector<Node::Entry> Node::Nodes;
+	AddressMap<Node::Entry> Node::Nodes;
 
 	bool Node::wasIngame = false;
 
+	std::vector<Node::WheelEntry> Node::Wheel[NODE_WHEEL_SLOTS];
+	int Node::WheelTick = 0;
+	std::deque<Network::Address> Node::RequestQueue;
+
 	bool Node::Entry::isValid()
 	{
 		return (this->lastResponse.has_value() && !this->lastResponse->elapsed(NODE_HALFLIFE * 2));
@@ -39,11 +43,38 @@ namespace Components
 		if (!this->lastRequest.has_value()) this->lastRequest.emplace(Utils::Time::Point());
 		this->lastRequest->update();
 
-		Session::Send(this->address, "nodeListRequest");
+		// Peers that understand delta lists only answer with the nodes missing from our digest
+		uint64_t seed;
+		Proto::Node::List request;
+		request.set_version(NODE_LIST_VERSION);
+		request.set_digest(Node::BuildDigest(&seed));
+		request.set_digestseed(seed);
+
+		Session::Send(this->address, "nodeListRequest", request.SerializeAsString());
 		Node::SendList(this->address);
 		NODE_LOG("Sent request to %s\n", this->address.getCString());
 	}
 
+	int Node::Entry::nextUpdate()
+	{
+		Utils::Time::Point now;
+		int delay = NODE_HALFLIFE;
+
+		if (this->lastRequest.has_value())
+		{
+			const auto remaining = NODE_HALFLIFE - this->lastRequest->diff(now);
+			if (remaining > 0) delay = std::min(delay, remaining);
+		}
+
+		if (this->lastResponse.has_value())
+		{
+			const auto remaining = NODE_HALFLIFE * 2 - this->lastResponse->diff(now);
+			if (remaining > 0) delay = std::min(delay, remaining);
+		}
+
+		return delay;
+	}
+
 	void Node::Entry::reset()
 	{
 		// this->lastResponse.reset(); // This would invalidate the node, but maybe we don't want that?
@@ -125,17 +156,21 @@ namespace Components
 		Node::Mutex.lock();
 		for (auto& node : Node::Nodes)
 		{
-			if (node.isValid())
+			if (node.second.isValid())
 			{
 				std::string* str = list.add_nodes();
 
-				sockaddr addr = node.address.getSockAddr();
+				sockaddr addr = node.second.address.getSockAddr();
 				str->append(reinterpret_cast<char*>(&addr), sizeof(addr));
 			}
 		}
 		Node::Mutex.unlock();
 
-		Utils::IO::WriteFile("players/nodes.dat", Utils::Compression::ZLib::Compress(list.SerializeAsString()));
+		// Serialization and compression happen on the persistence worker
+		Persistence::Store("players/nodes.dat", [list]()
+		{
+			return list.SerializeAsString();
+		}, true);
 	}
 
 	void Node::Add(Network::Address address)
@@ -147,22 +182,101 @@ namespace Components
 		if (!address.isValid()) return;
 
 		std::lock_guard<std::recursive_mutex> _(Node::Mutex);
-		for (auto& session : Node::Nodes)
-		{
-			if (session.address == address) return;
-		}
+		if (Node::Nodes.contains(address)) return;
 
-		Node::Entry node;
+		auto& node = Node::Nodes[address];
 		node.address = address;
+		node.generation = 0;
+		node.queued = false;
 
-		Node::Nodes.push_back(node);
+		Node::Enqueue(&node);
 	}
 
 	std::vector<Node::Entry> Node::GetNodes()
 	{
 		std::lock_guard<std::recursive_mutex> _(Node::Mutex);
 
-		return Node::Nodes;
+		std::vector<Entry> nodes;
+		nodes.reserve(Node::Nodes.size());
+
+		for (auto& node : Node::Nodes)
+		{
+			nodes.push_back(node.second);
+		}
+
+		return nodes;
+	}
+
+	int Node::GetTick()
+	{
+		return Game::Sys_Milliseconds() / NODE_WHEEL_RESOLUTION;
+	}
+
+	void Node::Schedule(Entry* node, int delay)
+	{
+		WheelEntry entry;
+		entry.address = node->address;
+		entry.generation = ++node->generation;
+		entry.tick = Node::GetTick() + std::max(1, (delay + NODE_WHEEL_RESOLUTION - 1) / NODE_WHEEL_RESOLUTION);
+
+		Node::Wheel[entry.tick % NODE_WHEEL_SLOTS].push_back(entry);
+	}
+
+	void Node::Enqueue(Entry* node)
+	{
+		// Pending wheel entries are obsolete once the node waits for a request
+		++node->generation;
+
+		if (node->queued) return;
+		node->queued = true;
+
+		Node::RequestQueue.push_back(node->address);
+	}
+
+	bool Node::Update(Entry* node)
+	{
+		if (node->isDead()) return false;
+
+		if (node->requiresRequest()) Node::Enqueue(node);
+		else Node::Schedule(node, node->nextUpdate());
+
+		return true;
+	}
+
+	void Node::AdvanceWheel()
+	{
+		const auto now = Node::GetTick();
+
+		// After a long pause, visiting every slot once is enough
+		if (now - Node::WheelTick > NODE_WHEEL_SLOTS) Node::WheelTick = now - NODE_WHEEL_SLOTS;
+
+		for (; Node::WheelTick < now; ++Node::WheelTick)
+		{
+			auto& slot = Node::Wheel[(Node::WheelTick + 1) % NODE_WHEEL_SLOTS];
+			if (slot.empty()) continue;
+
+			// Entries rescheduled while processing go to a fresh slot
+			std::vector<WheelEntry> entries;
+			entries.swap(slot);
+
+			for (auto& entry : entries)
+			{
+				auto node = Node::Nodes.find(entry.address);
+				if (node == Node::Nodes.end() || node->second.generation != entry.generation) continue;
+
+				// Scheduled for a later revolution
+				if (entry.tick > now)
+				{
+					slot.push_back(entry);
+					continue;
+				}
+
+				if (!Node::Update(&node->second))
+				{
+					Node::Nodes.erase(node);
+				}
+			}
+		}
 	}
 
 	void Node::RunFrame()
@@ -180,14 +294,18 @@ namespace Components
 			}
 		}
 
+		std::lock_guard<std::recursive_mutex> _(Node::Mutex);
+
 		if (wasIngame) // our last frame we were ingame and now we aren't so touch all nodes
 		{
-			for (auto i = Node::Nodes.begin(); i != Node::Nodes.end();++i)
+			for (auto& node : Node::Nodes)
 			{
 				// clearing the last request and response times makes the 
 				// dispatcher think its a new node and will force a refresh
-				i->lastRequest.reset();
-				i->lastResponse.reset();
+				node.second.lastRequest.reset();
+				node.second.lastResponse.reset();
+
+				Node::Enqueue(&node.second);
 			}
 			wasIngame = false;
 		}
@@ -197,24 +315,33 @@ namespace Components
 		if (!frameLimit.elapsed(std::chrono::milliseconds(interval))) return;
 		frameLimit.update();
 
-		std::lock_guard<std::recursive_mutex> _(Node::Mutex);
+		// Only nodes whose state is due to change are touched
+		Node::AdvanceWheel();
+
 		Dvar::Var queryLimit("net_serverQueryLimit");
 
 		int sentRequests = 0;
-		for (auto i = Node::Nodes.begin(); i != Node::Nodes.end();)
+		while (!Node::RequestQueue.empty() && sentRequests < queryLimit.get<int>())
 		{
-			if (i->isDead())
+			auto node = Node::Nodes.find(Node::RequestQueue.front());
+			Node::RequestQueue.pop_front();
+
+			if (node == Node::Nodes.end() || !node->second.queued) continue;
+			node->second.queued = false;
+
+			if (node->second.isDead())
 			{
-				i = Node::Nodes.erase(i);
+				Node::Nodes.erase(node);
 				continue;
 			}
-			else if (sentRequests < queryLimit.get<int>() && i->requiresRequest())
+
+			if (node->second.requiresRequest())
 			{
 				++sentRequests;
-				i->sendRequest();
+				node->second.sendRequest();
 			}
 
-			++i;
+			Node::Schedule(&node->second, node->second.nextUpdate());
 		}
 	}
 
@@ -225,20 +352,14 @@ namespace Components
 		{
 			//if (node.isValid()) // Comment out to simulate 'syncnodes' behaviour
 			{
-				node.reset();
+				node.second.reset();
+				Node::Enqueue(&node.second);
 			}
 		}
 	}
 
-	void Node::HandleResponse(Network::Address address, const std::string& data)
+	void Node::ParseList(const Proto::Node::List& list)
 	{
-		Proto::Node::List list;
-		if (!list.ParseFromString(data)) return;
-
-		NODE_LOG("Received response from %s\n", address.getCString());
-
-		std::lock_guard<std::recursive_mutex> _(Node::Mutex);
-
 		for (int i = 0; i < list.nodes_size(); ++i)
 		{
 			const std::string& addr = list.nodes(i);
@@ -249,6 +370,99 @@ namespace Components
 			}
 		}
 
+		const std::string& compactNodes = list.compactnodes();
+		for (size_t offset = 0; offset + NODE_COMPACT_SIZE <= compactNodes.size(); offset += NODE_COMPACT_SIZE)
+		{
+			Network::Address address;
+			address.setType(Game::NA_IP);
+			address.setIP(*reinterpret_cast<const DWORD*>(compactNodes.data() + offset));
+			address.setPort(ntohs(*reinterpret_cast<const unsigned short*>(compactNodes.data() + offset + 4)));
+
+			Node::Add(address);
+		}
+	}
+
+	void Node::UpdatePeer(Entry* node, const Proto::Node::List& list)
+	{
+		// Only some messages of a list carry the revision and the digest.
+		// A seed without digest means the sender's filter is saturated and it wants full lists.
+		if (list.version()) node->data.version = list.version();
+		if (!list.digest().empty() || list.digestseed())
+		{
+			node->data.digest = list.digest();
+			node->data.digestSeed = list.digestseed();
+		}
+	}
+
+	std::string Node::BuildDigest(uint64_t* seed)
+	{
+		// Older peers leave the seed at 0, which is the unseeded digest they understand
+		*seed = (static_cast<uint64_t>(Utils::Cryptography::Rand::GenerateInt()) << 32) | Utils::Cryptography::Rand::GenerateInt();
+
+		// Dead and invalid nodes are never sent, so they don't need to be in the filter either
+		size_t count = 0;
+		for (auto& node : Node::Nodes)
+		{
+			if (node.second.isValid()) ++count;
+		}
+
+		size_t bits = NODE_DIGEST_MIN_BITS;
+		while (bits < count * NODE_DIGEST_BITS_PER_NODE) bits <<= 1;
+
+		// Beyond that, most lookups would be false positives, peers send the full list for an empty digest
+		if (bits > NODE_DIGEST_MAX_BITS) return "";
+
+		std::string digest(bits / 8, 0);
+
+		for (auto& node : Node::Nodes)
+		{
+			if (!node.second.isValid()) continue;
+
+			const auto hash = Network::Address::Hash(node.second.address.getKey() ^ *seed);
+			const auto hash1 = static_cast<uint32_t>(hash);
+			const auto hash2 = static_cast<uint32_t>(hash >> 32) | 1;
+
+			for (uint32_t i = 0; i < NODE_DIGEST_HASHES; ++i)
+			{
+				const auto bit = (hash1 + i * hash2) & (bits - 1);
+				digest[bit / 8] |= static_cast<char>(1 << (bit % 8));
+			}
+		}
+
+		return digest;
+	}
+
+	bool Node::DigestContains(const std::string& digest, uint64_t seed, const Network::Address& address)
+	{
+		const auto bits = digest.size() * 8;
+
+		// Invalid digests make us send everything
+		if (bits < NODE_DIGEST_MIN_BITS || bits > NODE_DIGEST_MAX_BITS || (bits & (bits - 1))) return false;
+
+		const auto hash = Network::Address::Hash(address.getKey() ^ seed);
+		const auto hash1 = static_cast<uint32_t>(hash);
+		const auto hash2 = static_cast<uint32_t>(hash >> 32) | 1;
+
+		for (uint32_t i = 0; i < NODE_DIGEST_HASHES; ++i)
+		{
+			const auto bit = (hash1 + i * hash2) & (bits - 1);
+			if (!(digest[bit / 8] & (1 << (bit % 8)))) return false;
+		}
+
+		return true;
+	}
+
+	void Node::HandleResponse(Network::Address address, const std::string& data)
+	{
+		Proto::Node::List list;
+		if (!list.ParseFromString(data)) return;
+
+		NODE_LOG("Received response from %s\n", address.getCString());
+
+		std::lock_guard<std::recursive_mutex> _(Node::Mutex);
+
+		Node::ParseList(list);
+
 		if (list.isnode() && (!list.port() || list.port() == address.getPort()))
 		{
 			if (!Dedicated::IsEnabled() && ServerList::IsOnlineList() && !ServerList::useMasterServer && list.protocol() == PROTOCOL)
@@ -261,35 +475,38 @@ namespace Components
 				NODE_LOG("Dropping serverlist insertion for %s\n", address.getCString());
 			}
 
-			for (auto& node : Node::Nodes)
+			auto node = Node::Nodes.find(address);
+			if (node != Node::Nodes.end())
 			{
-				if (address == node.address)
-				{
-					if (!node.lastResponse.has_value()) node.lastResponse.emplace(Utils::Time::Point());
-					node.lastResponse->update();
+				if (!node->second.lastResponse.has_value()) node->second.lastResponse.emplace(Utils::Time::Point());
+				node->second.lastResponse->update();
 
-					node.data.protocol = list.protocol();
-					return;
-				}
+				node->second.data.protocol = list.protocol();
+				Node::UpdatePeer(&node->second, list);
+
+				// Queued nodes are evaluated when they are dequeued
+				if (!node->second.queued) Node::Schedule(&node->second, node->second.nextUpdate());
+				return;
 			}
 
-			Node::Entry entry;
+			auto& entry = Node::Nodes[address];
 			entry.address = address;
 			entry.data.protocol = list.protocol();
 			entry.lastResponse.emplace(Utils::Time::Point());
+			entry.generation = 0;
+			entry.queued = false;
 
-			Node::Nodes.push_back(entry);
+			Node::UpdatePeer(&entry, list);
+			Node::Enqueue(&entry);
 		}
 	}
 
-	void Node::SendList(Network::Address address)
+	std::vector<std::string> Node::BuildLegacyList()
 	{
-		std::lock_guard<std::recursive_mutex> _(Node::Mutex);
-
 		// need to keep the message size below 1404 bytes else recipient will just drop it
 		std::vector<std::string> nodeListReponseMessages;
 
-		for (size_t curNode = 0; curNode < Node::Nodes.size();)
+		for (auto curNode = Node::Nodes.begin(); curNode != Node::Nodes.end();)
 		{
 			Proto::Node::List list;
 			list.set_isnode(Dedicated::IsEnabled());
@@ -298,10 +515,11 @@ namespace Components
 
 			for (size_t i = 0; i < NODE_MAX_NODES_TO_SEND;)
 			{
-				if (curNode >= Node::Nodes.size())
+				if (curNode == Node::Nodes.end())
 					break;
 
-				auto node = Node::Nodes.at(curNode++);
+				auto& node = curNode->second;
+				++curNode;
 
 				if (node.isValid())
 				{
@@ -317,6 +535,109 @@ namespace Components
 			nodeListReponseMessages.push_back(list.SerializeAsString());
 		}
 
+		// Announce delta list support, older peers ignore the unknown fields
+		Proto::Node::List list;
+		list.set_isnode(Dedicated::IsEnabled());
+		list.set_protocol(PROTOCOL);
+		list.set_port(Node::GetPort());
+		list.set_version(NODE_LIST_VERSION);
+
+		uint64_t seed;
+		list.set_digest(Node::BuildDigest(&seed));
+		list.set_digestseed(seed);
+
+		nodeListReponseMessages.push_back(list.SerializeAsString());
+
+		return nodeListReponseMessages;
+	}
+
+	std::vector<std::string> Node::BuildDeltaList(const std::string& digest, uint64_t seed)
+	{
+		std::vector<std::string> nodeListReponseMessages;
+
+		uint64_t ownSeed;
+		Proto::Node::List list;
+		list.set_isnode(Dedicated::IsEnabled());
+		list.set_protocol(PROTOCOL);
+		list.set_port(Node::GetPort());
+		list.set_version(NODE_LIST_VERSION);
+		list.set_digest(Node::BuildDigest(&ownSeed));
+		list.set_digestseed(ownSeed);
+
+		size_t count = 0;
+		for (auto& node : Node::Nodes)
+		{
+			auto& address = node.second.address;
+			if (!node.second.isValid() || Node::DigestContains(digest, seed, address)) continue;
+
+			if (address.getType() == Game::NA_IP)
+			{
+				const auto ip = address.getIP().full;
+				const auto port = htons(address.getPort());
+
+				std::string* compactNodes = list.mutable_compactnodes();
+				compactNodes->append(reinterpret_cast<const char*>(&ip), sizeof(ip));
+				compactNodes->append(reinterpret_cast<const char*>(&port), sizeof(port));
+
+				++count;
+			}
+			else
+			{
+				std::string* str = list.add_nodes();
+
+				sockaddr addr = address.getSockAddr();
+				str->append(reinterpret_cast<char*>(&addr), sizeof(addr));
+
+				count += sizeof(sockaddr) / NODE_COMPACT_SIZE;
+			}
+
+			// The digest is only sent once, so the following messages can carry more nodes
+			if (count >= NODE_MAX_COMPACT_NODES_TO_SEND * (list.digest().empty() ? 2 : 1))
+			{
+				nodeListReponseMessages.push_back(list.SerializeAsString());
+
+				list.clear_nodes();
+				list.clear_compactnodes();
+				list.clear_digest();
+				list.clear_digestseed();
+				count = 0;
+			}
+		}
+
+		// Always answer, so the peer learns our digest even if it's up to date
+		if (count || nodeListReponseMessages.empty())
+		{
+			nodeListReponseMessages.push_back(list.SerializeAsString());
+		}
+
+		return nodeListReponseMessages;
+	}
+
+	void Node::SendList(Network::Address address, const Proto::Node::List* request)
+	{
+		std::lock_guard<std::recursive_mutex> _(Node::Mutex);
+
+		std::string peerDigest;
+		uint64_t peerSeed = 0;
+
+		if (request)
+		{
+			peerDigest = request->digest();
+			peerSeed = request->digestseed();
+		}
+		else
+		{
+			auto node = Node::Nodes.find(address);
+			if (node != Node::Nodes.end() && node->second.data.version >= NODE_LIST_VERSION)
+			{
+				peerDigest = node->second.data.digest;
+				peerSeed = node->second.data.digestSeed;
+			}
+		}
+
+		// Peers that never sent a digest get the full list
+		auto nodeListReponseMessages = peerDigest.empty() ? Node::BuildLegacyList() : Node::BuildDeltaList(peerDigest, peerSeed);
+
 		size_t i = 0;
 		for (auto& nodeListData : nodeListReponseMessages)
 		{
@@ -346,8 +667,22 @@ namespace Components
 
 		Scheduler::OnFrame(Node::RunFrame);
 		Session::Handle("nodeListResponse", Node::HandleResponse);
-		Session::Handle("nodeListRequest", [](Network::Address address, const std::string&)
+		Session::Handle("nodeListRequest", [](Network::Address address, const std::string& data)
 		{
+			// Requests from older peers are empty
+			Proto::Node::List request;
+			if (!data.empty() && request.ParseFromString(data) && request.version() >= NODE_LIST_VERSION)
+			{
+				std::lock_guard<std::recursive_mutex> _(Node::Mutex);
+
+				auto node = Node::Nodes.find(address);
+				if (node != Node::Nodes.end()) Node::UpdatePeer(&node->second, request);
+
+				// Saturated digests are empty and get the full list
+				Node::SendList(address, &request);
+				return;
+			}
+
 			Node::SendList(address);
 		});
 
@@ -376,7 +711,7 @@ namespace Components
 			std::lock_guard<std::recursive_mutex> _(Node::Mutex);
 			for (auto& node : Node::Nodes)
 			{
-				Logger::Print("%s\t(%s)\n", node.address.getCString(), node.isValid() ? "Valid" : "Invalid");
+				Logger::Print("%s\t(%s)\n", node.second.address.getCString(), node.second.isValid() ? "Valid" : "Invalid");
 			}
 		});
 
@@ -392,5 +727,11 @@ namespace Components
 		std::lock_guard<std::recursive_mutex> _(Node::Mutex);
 		Node::StoreNodes(true);
 		Node::Nodes.clear();
+		Node::RequestQueue.clear();
+
+		for (auto& slot : Node::Wheel)
+		{
+			slot.clear();
+		}
 	}
 }
@@ -4,6 +4,19 @@
 #define NODE_MAX_NODES_TO_SEND 64
 #define NODE_SEND_RATE 500ms
 
+// Delta node lists, see Node::SendList
+#define NODE_LIST_VERSION 1
+#define NODE_MAX_COMPACT_NODES_TO_SEND 96
+#define NODE_COMPACT_SIZE 6
+#define NODE_DIGEST_MIN_BITS 512
+#define NODE_DIGEST_MAX_BITS 4096
+#define NODE_DIGEST_HASHES 4
+#define NODE_DIGEST_BITS_PER_NODE 10 // About 1% false positives with 4 hashes
+
+// Timing wheel for node state transitions, spans a bit more than four minutes
+#define NODE_WHEEL_SLOTS 256
+#define NODE_WHEEL_RESOLUTION 1000 // ms per slot
+
 #ifdef NODE_LOG_MESSAGES
 #define NODE_LOG(x, ...) Logger::Print(x, __VA_ARGS__)
 #else
@@ -19,6 +32,11 @@ namespace Components
 		{
 		public:
 			uint64_t protocol;
+
+			// Node list revision and the last digest received from the peer
+			uint32_t version;
+			std::string digest;
+			uint64_t digestSeed;
 		};
 
 		class Entry
@@ -30,12 +48,19 @@ namespace Components
 			std::optional<Utils::Time::Point> lastRequest;
 			std::optional<Utils::Time::Point> lastResponse;
 
+			// Invalidates wheel entries scheduled before the last state change
+			unsigned int generation;
+			bool queued;
+
 			bool isValid();
 			bool isDead();
 
 			bool requiresRequest();
 			void sendRequest();
 
+			// Milliseconds until isDead or requiresRequest may change
+			int nextUpdate();
+
 			void reset();
 			json11::Json to_json() const;
 		};
@@ -51,13 +76,39 @@ namespace Components
 		static void LoadNodeRemotePreset();
 
 	private:
+		class WheelEntry
+		{
+		public:
+			Network::Address address;
+			unsigned int generation;
+			int tick;
+		};
+
 		static std::recursive_mutex Mutex;
-		static std::vector<Entry> Nodes;
+		static AddressMap<Entry> Nodes;
 		static bool wasIngame;
 
+		static std::vector<WheelEntry> Wheel[NODE_WHEEL_SLOTS];
+		static int WheelTick;
+		static std::deque<Network::Address> RequestQueue;
+
+		static int GetTick();
+		static void Schedule(Entry* node, int delay);
+		static void Enqueue(Entry* node);
+		static bool Update(Entry* node);
+		static void AdvanceWheel();
+
 		static void HandleResponse(Network::Address address, const std::string& data);
 
-		static void SendList(Network::Address address);
+		static void SendList(Network::Address address, const Proto::Node::List* request = nullptr);
+		static std::vector<std::string> BuildLegacyList();
+		static std::vector<std::string> BuildDeltaList(const std::string& digest, uint64_t seed);
+
+		// Picks a fresh seed for every digest, empty if the valid nodes would saturate it
+		static std::string BuildDigest(uint64_t* seed);
+		static bool DigestContains(const std::string& digest, uint64_t seed, const Network::Address& address);
+		static void ParseList(const Proto::Node::List& list);
+		static void UpdatePeer(Entry* node, const Proto::Node::List& list);
 
 		static void LoadNodePreset();
 		static void LoadNodes();
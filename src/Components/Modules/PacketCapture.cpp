@@ -0,0 +1,282 @@
+#include <STDInclude.hpp>
+
+namespace Components
+{
+	std::ofstream PacketCapture::CaptureStream;
+	std::chrono::high_resolution_clock::time_point PacketCapture::LastRecord;
+	unsigned int PacketCapture::CapturedPackets;
+
+	std::unique_ptr<PacketCapture::Replay> PacketCapture::CurrentReplay;
+
+	// Handlers that execute commands, change the server list, node registry or party, or reply later from other threads
+	const char* PacketCapture::ReplayExclusions[] =
+	{
+		"rcon",
+		"rconrequest",
+		"rconexecute",
+		"getserversresponse",
+		"discovery",
+		"inforesponse",
+		"statusresponse",
+		"discoveryresponse",
+		"playlistresponse",
+		"playlistinvalidpassword",
+		"sessionsyn",
+		"sessionack",
+		"sessionfin",
+	};
+
+	void PacketCapture::Record(Game::netadr_t* from, Game::msg_t* msg, const std::string& command)
+	{
+		if (!PacketCapture::CaptureStream.is_open() || msg->cursize <= 0) return;
+		if (Utils::String::StartsWith(Utils::String::ToLower(command), "rcon")) return;
+
+		const auto now = std::chrono::high_resolution_clock::now();
+		const auto delta = std::chrono::duration_cast<std::chrono::microseconds>(now - PacketCapture::LastRecord).count();
+		PacketCapture::LastRecord = now;
+
+		RecordHeader header;
+		header.delta = static_cast<uint32_t>(std::min<long long>(delta, std::numeric_limits<uint32_t>::max()));
+		header.ip = from->ip.full;
+		header.port = from->port;
+		header.length = static_cast<uint32_t>(msg->cursize);
+
+		PacketCapture::CaptureStream.write(reinterpret_cast<char*>(&header), sizeof(header));
+		PacketCapture::CaptureStream.write(msg->data, msg->cursize);
+
+		++PacketCapture::CapturedPackets;
+	}
+
+	bool PacketCapture::StartCapture(const std::string& file)
+	{
+		PacketCapture::StopCapture();
+
+		PacketCapture::CaptureStream.open(file, std::ios::binary | std::ios::trunc);
+		if (!PacketCapture::CaptureStream.is_open()) return false;
+
+		const uint32_t version = PACKETCAPTURE_VERSION;
+		PacketCapture::CaptureStream.write(PACKETCAPTURE_MAGIC, sizeof(PACKETCAPTURE_MAGIC) - 1);
+		PacketCapture::CaptureStream.write(reinterpret_cast<const char*>(&version), sizeof(version));
+
+		PacketCapture::LastRecord = std::chrono::high_resolution_clock::now();
+		PacketCapture::CapturedPackets = 0;
+		return true;
+	}
+
+	void PacketCapture::StopCapture()
+	{
+		if (!PacketCapture::CaptureStream.is_open()) return;
+
+		PacketCapture::CaptureStream.close();
+		Logger::Print("Packet capture stopped, %u packets recorded\n", PacketCapture::CapturedPackets);
+	}
+
+	bool PacketCapture::LoadCapture(const std::string& file, std::vector<CapturedPacket>* packets)
+	{
+		std::string data;
+		if (!Utils::IO::ReadFile(file, &data)) return false;
+
+		const size_t headerSize = sizeof(PACKETCAPTURE_MAGIC) - 1 + sizeof(uint32_t);
+		if (data.size() < headerSize || data.compare(0, sizeof(PACKETCAPTURE_MAGIC) - 1, PACKETCAPTURE_MAGIC) != 0) return false;
+		if (*reinterpret_cast<const uint32_t*>(data.data() + sizeof(PACKETCAPTURE_MAGIC) - 1) != PACKETCAPTURE_VERSION) return false;
+
+		unsigned long long time = 0;
+
+		for (size_t offset = headerSize; offset + sizeof(RecordHeader) <= data.size();)
+		{
+			const auto* header = reinterpret_cast<const RecordHeader*>(data.data() + offset);
+			offset += sizeof(RecordHeader);
+
+			// Truncated capture, keep what we have
+			if (header->length > data.size() - offset) break;
+
+			time += header->delta;
+
+			// Replayed packets come from loopback, so nothing handlers send in return reaches the recorded sources
+			Game::netadr_t address;
+			ZeroMemory(&address, sizeof(address));
+			address.type = Game::netadrtype_t::NA_LOOPBACK;
+			address.port = header->port;
+
+			CapturedPacket packet;
+			packet.time = time;
+			packet.source = address;
+			packet.data = data.substr(offset, header->length);
+			packets->push_back(packet);
+
+			offset += header->length;
+		}
+
+		return true;
+	}
+
+	void PacketCapture::StartReplay(const std::string& file, bool realtime)
+	{
+		if (PacketCapture::CurrentReplay)
+		{
+			Logger::Print("A replay is already running\n");
+			return;
+		}
+
+		// Handlers run inside this process, don't let a replay touch a live game
+		if (Dvar::Var("sv_running").get<bool>() || Party::IsInLobby())
+		{
+			Logger::Print("Packet captures can't be replayed while a server or party is running\n");
+			return;
+		}
+
+		auto replay = std::make_unique<Replay>();
+		if (!PacketCapture::LoadCapture(file, &replay->packets))
+		{
+			Logger::Print("Failed to load packet capture '%s'\n", file.data());
+			return;
+		}
+
+		replay->current = 0;
+		replay->realtime = realtime;
+		replay->unhandled = 0;
+		replay->skipped = 0;
+		replay->start = std::chrono::high_resolution_clock::now();
+
+		PacketCapture::CurrentReplay = std::move(replay);
+
+		Logger::Print("Replaying %u packets from '%s'...\n", PacketCapture::CurrentReplay->packets.size(), file.data());
+
+		// At maximum speed, everything is dispatched right away
+		if (!realtime) PacketCapture::RunReplay();
+	}
+
+	void PacketCapture::RunReplay()
+	{
+		auto* replay = PacketCapture::CurrentReplay.get();
+		if (!replay) return;
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - replay->start).count();
+
+		for (; replay->current < replay->packets.size(); ++replay->current)
+		{
+			auto& packet = replay->packets[replay->current];
+			if (replay->realtime && packet.time > static_cast<unsigned long long>(elapsed)) return;
+
+			// A realtime replay must not keep running into a map or lobby started in the meantime
+			if (Dvar::Var("sv_running").get<bool>() || Party::IsInLobby())
+			{
+				Logger::Print("Server or party started, aborting replay\n");
+				break;
+			}
+
+			// Strip the OOB header
+			if (packet.data.size() < 4)
+			{
+				++replay->unhandled;
+				continue;
+			}
+
+			if (PacketCapture::IsExcluded(packet.data.substr(4)))
+			{
+				++replay->skipped;
+				continue;
+			}
+
+			std::string command;
+			const auto start = std::chrono::high_resolution_clock::now();
+
+			Network::SuppressReplies(true);
+			const auto handled = Network::Dispatch(packet.source, packet.data.substr(4), &command);
+			Network::SuppressReplies(false);
+
+			const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+			if (handled) replay->latencies[command].push_back(static_cast<unsigned int>(duration));
+			else ++replay->unhandled;
+		}
+
+		PacketCapture::FinishReplay();
+	}
+
+	bool PacketCapture::IsExcluded(const std::string& packet)
+	{
+		const auto command = Utils::String::ToLower(packet.substr(0, packet.find_first_of("\\\n ")));
+
+		for (auto* exclusion : PacketCapture::ReplayExclusions)
+		{
+			if (command == exclusion) return true;
+		}
+
+		return false;
+	}
+
+	void PacketCapture::FinishReplay()
+	{
+		auto replay = std::move(PacketCapture::CurrentReplay);
+
+		const auto total = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - replay->start).count();
+		const auto packets = replay->packets.size();
+
+		Logger::Print("Replayed %u packets in %lli ms (%.0f packets/s), %u unhandled, %u skipped\n", packets, total / 1000,
+			total ? packets * 1000000.0 / total : 0.0, replay->unhandled, replay->skipped);
+
+		Logger::Print("%-24s %10s %10s %10s %10s %10s\n", "command", "packets", "p50 (us)", "p90 (us)", "p99 (us)", "max (us)");
+
+		for (auto& handler : replay->latencies)
+		{
+			auto& latencies = handler.second;
+			std::sort(latencies.begin(), latencies.end());
+
+			auto percentile = [&latencies](double p)
+			{
+				return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+			};
+
+			Logger::Print("%-24s %10u %10u %10u %10u %10u\n", handler.first.data(), latencies.size(),
+				percentile(0.5), percentile(0.9), percentile(0.99), latencies.back());
+		}
+	}
+
+	PacketCapture::PacketCapture()
+	{
+		Command::Add("net_capture", [](Command::Params* params)
+		{
+			if (params->size() > 1 && params->get(1) == "stop"s)
+			{
+				PacketCapture::StopCapture();
+				return;
+			}
+
+			if (params->size() < 2 || params->get(1) != "start"s)
+			{
+				Logger::Print("Usage: net_capture start [file] | stop\n");
+				return;
+			}
+
+			const std::string file = params->size() > 2 ? params->get(2) : "packets.cap";
+			if (PacketCapture::StartCapture(file))
+			{
+				Logger::Print("Capturing inbound packets to '%s'\n", file.data());
+			}
+			else
+			{
+				Logger::Print("Failed to open '%s' for writing\n", file.data());
+			}
+		});
+
+		Command::Add("net_replay", [](Command::Params* params)
+		{
+			if (params->size() < 2)
+			{
+				Logger::Print("Usage: net_replay <file> [realtime]\n");
+				return;
+			}
+
+			PacketCapture::StartReplay(params->get(1), params->size() > 2 && params->get(2) == "realtime"s);
+		});
+
+		Scheduler::OnFrame(PacketCapture::RunReplay);
+	}
+
+	PacketCapture::~PacketCapture()
+	{
+		PacketCapture::CaptureStream.close();
+		PacketCapture::CurrentReplay.reset();
+	}
+}
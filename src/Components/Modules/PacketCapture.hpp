@@ -0,0 +1,67 @@
+#pragma once
+
+#define PACKETCAPTURE_MAGIC "IW4xPCAP"
+#define PACKETCAPTURE_VERSION 1
+
+namespace Components
+{
+	class PacketCapture : public Component
+	{
+	public:
+		PacketCapture();
+		~PacketCapture();
+
+		// Rcon packets carry the password, they are never written to disk
+		static void Record(Game::netadr_t* from, Game::msg_t* msg, const std::string& command);
+
+	private:
+#pragma pack(push, 1)
+		// Followed by length bytes of raw packet data, including the OOB header
+		struct RecordHeader
+		{
+			uint32_t delta; // Microseconds since the previous record
+			uint32_t ip;
+			uint16_t port;
+			uint32_t length;
+		};
+#pragma pack(pop)
+
+		class CapturedPacket
+		{
+		public:
+			unsigned long long time; // Microseconds since the start of the capture
+			Network::Address source;
+			std::string data;
+		};
+
+		class Replay
+		{
+		public:
+			std::vector<CapturedPacket> packets;
+			size_t current;
+			bool realtime;
+
+			std::chrono::high_resolution_clock::time_point start;
+			std::map<std::string, std::vector<unsigned int>> latencies; // Microseconds per handler
+			size_t unhandled;
+			size_t skipped;
+		};
+
+		static std::ofstream CaptureStream;
+		static std::chrono::high_resolution_clock::time_point LastRecord;
+		static unsigned int CapturedPackets;
+
+		static std::unique_ptr<Replay> CurrentReplay;
+		static const char* ReplayExclusions[];
+
+		static bool IsExcluded(const std::string& packet);
+
+		static bool StartCapture(const std::string& file);
+		static void StopCapture();
+
+		static bool LoadCapture(const std::string& file, std::vector<CapturedPacket>* packets);
+		static void StartReplay(const std::string& file, bool realtime);
+		static void RunReplay();
+		static void FinishReplay();
+	};
+}
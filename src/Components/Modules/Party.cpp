@@ -305,89 +305,7 @@ namespace Components
 		// Basic info handler
 		Network::Handle("getInfo", [](Network::Address address, const std::string& data)
 		{
-			int botCount = 0;
-			int clientCount = 0;
-			int maxclientCount = *Game::svs_clientCount;
-
-			if (maxclientCount)
-			{
-				for (int i = 0; i < maxclientCount; ++i)
-				{
-					if (Game::svs_clients[i].state >= 3)
-					{
-						if (Game::svs_clients[i].bIsTestClient) ++botCount;
-						else ++clientCount;
-					}
-				}
-			}
-			else
-			{
-				maxclientCount = Dvar::Var("party_maxplayers").get<int>();
-				//maxclientCount = Game::Party_GetMaxPlayers(*Game::partyIngame);
-				clientCount = Game::PartyHost_CountMembers(reinterpret_cast<Game::PartyData_s*>(0x1081C00));
-			}
-
-			Utils::InfoString info;
-			info.set("challenge", Utils::ParseChallenge(data));
-			info.set("gamename", "IW4");
-			info.set("hostname", Dvar::Var("sv_hostname").get<const char*>());
-			info.set("gametype", Dvar::Var("g_gametype").get<const char*>());
-			info.set("fs_game", Dvar::Var("fs_game").get<const char*>());
-			info.set("xuid", Utils::String::VA("%llX", Steam::SteamUser()->GetSteamID().bits));
-			info.set("clients", Utils::String::VA("%i", clientCount));
-			info.set("bots", Utils::String::VA("%i", botCount));
-			info.set("sv_maxclients", Utils::String::VA("%i", maxclientCount));
-			info.set("protocol", Utils::String::VA("%i", PROTOCOL));
-			info.set("shortversion", SHORTVERSION);
-			info.set("checksum", Utils::String::VA("%d", Game::Sys_Milliseconds()));
-			info.set("mapname", Dvar::Var("mapname").get<const char*>());
-			info.set("isPrivate", (Dvar::Var("g_password").get<std::string>().size() ? "1" : "0"));
-			info.set("hc", (Dvar::Var("g_hardcore").get<bool>() ? "1" : "0"));
-			info.set("securityLevel", Utils::String::VA("%i", Dvar::Var("sv_securityLevel").get<int>()));
-			info.set("sv_running", (Dvar::Var("sv_running").get<bool>() ? "1" : "0"));
-
-			// Ensure mapname is set
-			if (info.get("mapname").empty() || Party::IsInLobby())
-			{
-				info.set("mapname", Dvar::Var("ui_mapname").get<const char*>());
-			}
-
-			if (Maps::GetUserMap()->isValid())
-			{
-				info.set("usermaphash", Utils::String::VA("%i", Maps::GetUserMap()->getHash()));
-			}
-			else if (Party::IsInUserMapLobby())
-			{
-				info.set("usermaphash", Utils::String::VA("%i", Maps::GetUsermapHash(info.get("mapname"))));
-			}
-
-			if (Dedicated::IsEnabled())
-			{
-				info.set("sv_motd", Dvar::Var("sv_motd").get<std::string>());
-			}
-
-			// Set matchtype
-			// 0 - No match, connecting not possible
-			// 1 - Party, use Steam_JoinLobby to connect
-			// 2 - Match, use CL_ConnectFromParty to connect
-
-			if (Dvar::Var("party_enable").get<bool>() && Dvar::Var("party_host").get<bool>()) // Party hosting
-			{
-				info.set("matchtype", "1");
-			}
-			else if (Dvar::Var("sv_running").get<bool>()) // Match hosting
-			{
-				info.set("matchtype", "2");
-			}
-			else
-			{
-				info.set("matchtype", "0");
-			}
-
-			info.set("wwwDownload", (Dvar::Var("sv_wwwDownload").get<bool>() ? "1" : "0"));
-			info.set("wwwUrl", Dvar::Var("sv_wwwBaseUrl").get<std::string>());
-
-			Network::SendCommand(address, "infoResponse", "\\" + info.build());
+			Network::SendCommand(address, "infoResponse", ServerInfo::GetInfoResponse(Utils::ParseChallenge(data)));
 		});
 
 		Network::Handle("infoResponse", [](Network::Address address, const std::string& data)
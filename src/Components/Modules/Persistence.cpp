@@ -0,0 +1,235 @@
+#include <STDInclude.hpp>
+
+namespace Components
+{
+	bool Persistence::Running = false;
+	bool Persistence::Terminate = false;
+	bool Persistence::Busy = false;
+	unsigned int Persistence::FlushRequests = 0;
+	std::thread Persistence::WorkerThread;
+	std::mutex Persistence::Mutex;
+	std::condition_variable Persistence::Condition;
+	std::condition_variable Persistence::IdleCondition;
+
+	std::unordered_map<std::string, Persistence::Job> Persistence::Pending;
+
+	Persistence::Job* Persistence::GetJob(const std::string& file, std::chrono::milliseconds delay)
+	{
+		const auto due = std::chrono::steady_clock::now() + delay;
+
+		auto job = Persistence::Pending.find(file);
+		if (job == Persistence::Pending.end())
+		{
+			auto& entry = Persistence::Pending[file];
+			entry.file = file;
+			entry.compress = false;
+			entry.due = due;
+			return &entry;
+		}
+
+		// Coalesced writes keep the earlier deadline, so constant submissions can't starve a file
+		job->second.due = std::min(job->second.due, due);
+		return &job->second;
+	}
+
+	void Persistence::Store(const std::string& file, Utils::Slot<Serializer> serializer, bool compress, std::chrono::milliseconds delay)
+	{
+		{
+			std::lock_guard<std::mutex> _(Persistence::Mutex);
+
+			if (Persistence::Running)
+			{
+				auto* job = Persistence::GetJob(file, delay);
+
+				// The new snapshot supersedes everything that is pending
+				job->serializer = serializer;
+				job->compress = compress;
+				job->append.clear();
+				job->header.clear();
+
+				Persistence::Condition.notify_one();
+				return;
+			}
+		}
+
+		// Without the worker, e.g. during shutdown, write right away
+		Job job;
+		job.file = file;
+		job.serializer = serializer;
+		job.compress = compress;
+		Persistence::Process(job);
+	}
+
+	void Persistence::Append(const std::string& file, const std::string& data, const std::string& header, std::chrono::milliseconds delay)
+	{
+		{
+			std::lock_guard<std::mutex> _(Persistence::Mutex);
+
+			if (Persistence::Running)
+			{
+				auto* job = Persistence::GetJob(file, delay);
+				job->append.append(data);
+				if (job->header.empty()) job->header = header;
+
+				Persistence::Condition.notify_one();
+				return;
+			}
+		}
+
+		Job job;
+		job.file = file;
+		job.compress = false;
+		job.append = data;
+		job.header = header;
+		Persistence::Process(job);
+	}
+
+	void Persistence::Flush()
+	{
+		std::unique_lock<std::mutex> lock(Persistence::Mutex);
+		if (!Persistence::Running) return;
+
+		++Persistence::FlushRequests;
+		Persistence::Condition.notify_one();
+
+		Persistence::IdleCondition.wait(lock, []
+		{
+			return Persistence::Pending.empty() && !Persistence::Busy;
+		});
+
+		--Persistence::FlushRequests;
+	}
+
+	bool Persistence::WriteAtomic(const std::string& file, const std::string& data)
+	{
+		// Readers either see the old or the new file, never a partial write
+		const auto temp = file + ".tmp";
+		if (!Utils::IO::WriteFile(temp, data)) return false;
+
+		if (!MoveFileExA(temp.data(), file.data(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		{
+			Utils::IO::RemoveFile(temp);
+			return false;
+		}
+
+		return true;
+	}
+
+	void Persistence::Process(Job& job)
+	{
+		if (job.serializer)
+		{
+			auto data = job.serializer();
+			if (job.compress) data = Utils::Compression::ZLib::Compress(data);
+
+			if (!Persistence::WriteAtomic(job.file, data))
+			{
+				Logger::Print("Failed to write '%s'\n", job.file.data());
+			}
+		}
+
+		if (!job.append.empty())
+		{
+			if (!job.header.empty() && !Utils::IO::FileExists(job.file))
+			{
+				Utils::IO::WriteFile(job.file, job.header);
+			}
+
+			Utils::IO::WriteFile(job.file, job.append, true);
+		}
+	}
+
+	void Persistence::Worker()
+	{
+		while (true)
+		{
+			Job job;
+
+			{
+				std::unique_lock<std::mutex> lock(Persistence::Mutex);
+
+				while (true)
+				{
+					if (Persistence::Pending.empty())
+					{
+						// Drain the queue before terminating, so pending writes are not lost
+						if (Persistence::Terminate) return;
+
+						Persistence::Condition.wait(lock);
+						continue;
+					}
+
+					auto next = std::min_element(Persistence::Pending.begin(), Persistence::Pending.end(), [](const auto& job1, const auto& job2)
+					{
+						return job1.second.due < job2.second.due;
+					});
+
+					if (!Persistence::Terminate && !Persistence::FlushRequests && next->second.due > std::chrono::steady_clock::now())
+					{
+						Persistence::Condition.wait_until(lock, next->second.due);
+						continue;
+					}
+
+					job = std::move(next->second);
+					Persistence::Pending.erase(next);
+					Persistence::Busy = true;
+					break;
+				}
+			}
+
+			Persistence::Process(job);
+
+			{
+				std::lock_guard<std::mutex> _(Persistence::Mutex);
+				Persistence::Busy = false;
+			}
+
+			Persistence::IdleCondition.notify_all();
+		}
+	}
+
+	Persistence::Persistence()
+	{
+		if (Loader::IsPerformingUnitTests()) return;
+
+		Persistence::Running = true;
+		Persistence::Terminate = false;
+		Persistence::WorkerThread = std::thread(Persistence::Worker);
+
+		Scheduler::OnShutdown(Persistence::Flush);
+	}
+
+	Persistence::~Persistence()
+	{
+		Persistence::Pending.clear();
+	}
+
+	void Persistence::preDestroy()
+	{
+		{
+			std::lock_guard<std::mutex> _(Persistence::Mutex);
+			Persistence::Terminate = true;
+		}
+
+		Persistence::Condition.notify_all();
+
+		if (Persistence::WorkerThread.joinable())
+		{
+			Persistence::WorkerThread.join();
+		}
+
+		// Later submissions are written synchronously, including those that raced with the worker's exit
+		std::unordered_map<std::string, Job> remaining;
+
+		{
+			std::lock_guard<std::mutex> _(Persistence::Mutex);
+			Persistence::Running = false;
+			remaining.swap(Persistence::Pending);
+		}
+
+		for (auto& job : remaining)
+		{
+			Persistence::Process(job.second);
+		}
+	}
+}
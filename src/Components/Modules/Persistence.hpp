@@ -0,0 +1,57 @@
+#pragma once
+
+// Time a write may wait for further submissions to the same file
+#define PERSISTENCE_DEFAULT_DELAY 2000ms
+
+namespace Components
+{
+	class Persistence : public Component
+	{
+	public:
+		typedef std::string(Serializer)();
+
+		Persistence();
+		~Persistence();
+
+		void preDestroy() override;
+
+		// Replaces the file with the output of the serializer, which runs on the worker thread.
+		// It must only access the snapshot it captured. Pending writes to the same file are coalesced.
+		static void Store(const std::string& file, Utils::Slot<Serializer> serializer, bool compress = false, std::chrono::milliseconds delay = PERSISTENCE_DEFAULT_DELAY);
+
+		// Appends to the file, the header is written first if the file doesn't exist yet
+		static void Append(const std::string& file, const std::string& data, const std::string& header = {}, std::chrono::milliseconds delay = PERSISTENCE_DEFAULT_DELAY);
+
+		// Blocks until all pending writes are on disk
+		static void Flush();
+
+	private:
+		class Job
+		{
+		public:
+			std::string file;
+			Utils::Slot<Serializer> serializer;
+			bool compress;
+			std::string append;
+			std::string header;
+			std::chrono::steady_clock::time_point due;
+		};
+
+		static bool Running;
+		static bool Terminate;
+		static bool Busy;
+		static unsigned int FlushRequests;
+		static std::thread WorkerThread;
+		static std::mutex Mutex;
+		static std::condition_variable Condition;
+		static std::condition_variable IdleCondition;
+
+		// Guarded by Mutex, one job per file
+		static std::unordered_map<std::string, Job> Pending;
+
+		static Job* GetJob(const std::string& file, std::chrono::milliseconds delay);
+		static void Process(Job& job);
+		static bool WriteAtomic(const std::string& file, const std::string& data);
+		static void Worker();
+	};
+}
@@ -0,0 +1,295 @@
+#include <STDInclude.hpp>
+
+namespace Components
+{
+	Dvar::Var ScriptFileIO::QueueLimit;
+
+	bool ScriptFileIO::Terminate;
+	std::thread ScriptFileIO::WorkerThread;
+	std::mutex ScriptFileIO::Mutex;
+	std::condition_variable ScriptFileIO::Condition;
+
+	std::deque<std::shared_ptr<ScriptFileIO::Request>> ScriptFileIO::Pending;
+	std::unordered_map<std::string, std::shared_ptr<ScriptFileIO::Request>> ScriptFileIO::LastPending;
+
+	std::vector<std::shared_ptr<ScriptFileIO::Request>> ScriptFileIO::Requests;
+
+	bool ScriptFileIO::IsPathAllowed(const char* function, const char* path)
+	{
+		if (path == nullptr)
+		{
+			Game::Scr_ParamError(0, Utils::String::VA("^1%s: filepath is not defined!\n", function));
+			return false;
+		}
+
+		static const char* queryStrings[] = { R"(..)", R"(../)", R"(..\)" };
+		for (auto i = 0u; i < ARRAYSIZE(queryStrings); ++i)
+		{
+			if (std::strstr(path, queryStrings[i]) != nullptr)
+			{
+				Logger::Print("^1%s: directory traversal is not allowed!\n", function);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	std::string ScriptFileIO::GetAbsolutePath(const char* path)
+	{
+		// Resolved on the main thread, the worker must not touch the game's filesystem.
+		// Unlike the synchronous functions, archives are never searched.
+		char buffer[MAX_PATH] = { 0 };
+		Game::FS_BuildPathToFile(Dvar::Var("fs_basepath").get<const char*>(), reinterpret_cast<char*>(0x63D0BB8), path, reinterpret_cast<char**>(&buffer));
+		return buffer;
+	}
+
+	void ScriptFileIO::Submit(Operation operation, const char* path, const std::string& data)
+	{
+		const auto isWrite = (operation == Operation::Write || operation == Operation::Append);
+		const auto absolutePath = ScriptFileIO::GetAbsolutePath(path);
+
+		std::shared_ptr<Request> request;
+
+		{
+			std::lock_guard<std::mutex> _(ScriptFileIO::Mutex);
+
+			// Coalesce consecutive writes to the same file, as long as nothing else is queued for it in between
+			const auto last = ScriptFileIO::LastPending.find(absolutePath);
+			if (isWrite && last != ScriptFileIO::LastPending.end() && (last->second->operation == Operation::Write || last->second->operation == Operation::Append))
+			{
+				request = last->second;
+
+				if (operation == Operation::Write)
+				{
+					request->operation = Operation::Write;
+					request->data = data;
+				}
+				else
+				{
+					request->data.append(data);
+				}
+			}
+			else if (ScriptFileIO::Pending.size() < static_cast<size_t>(ScriptFileIO::QueueLimit.get<int>()))
+			{
+				request = std::make_shared<Request>(operation, absolutePath);
+				request->data = data;
+
+				ScriptFileIO::Pending.push_back(request);
+				ScriptFileIO::LastPending[absolutePath] = request;
+			}
+		}
+
+		if (!request)
+		{
+			Logger::Print("^1File I/O queue is full, dropping request for '%s'!\n", path);
+
+			// Still hand out an object, it will be notified with a failure on the next frame
+			request = std::make_shared<Request>(operation, absolutePath);
+			request->done = true;
+		}
+		else
+		{
+			ScriptFileIO::Condition.notify_one();
+		}
+
+		// Requests without objects are not tracked, this includes merge targets whose objects were released on VM shutdown
+		if (request->objects.empty())
+		{
+			ScriptFileIO::Requests.push_back(request);
+		}
+
+		// The reference from AllocObject is released once the object has been notified
+		const auto object = Game::AllocObject();
+		Game::Scr_AddObject(object);
+		request->objects.push_back(object);
+	}
+
+	void ScriptFileIO::Process(Request* request)
+	{
+		switch (request->operation)
+		{
+		case Operation::Read:
+			request->success = Utils::IO::ReadFile(request->path, &request->result);
+			break;
+
+		case Operation::Write:
+		case Operation::Append:
+			request->success = Utils::IO::WriteFile(request->path, request->data, request->operation == Operation::Append);
+			request->data.clear();
+			break;
+
+		case Operation::Exists:
+			request->success = Utils::IO::FileExists(request->path);
+			break;
+
+		case Operation::Remove:
+			request->success = Utils::IO::RemoveFile(request->path);
+			break;
+		}
+	}
+
+	void ScriptFileIO::Worker()
+	{
+		while (true)
+		{
+			std::shared_ptr<Request> request;
+
+			{
+				std::unique_lock<std::mutex> lock(ScriptFileIO::Mutex);
+				ScriptFileIO::Condition.wait(lock, []
+				{
+					return ScriptFileIO::Terminate || !ScriptFileIO::Pending.empty();
+				});
+
+				// Drain the queue before terminating, so pending writes are not lost
+				if (ScriptFileIO::Pending.empty()) break;
+
+				request = ScriptFileIO::Pending.front();
+				ScriptFileIO::Pending.pop_front();
+
+				const auto last = ScriptFileIO::LastPending.find(request->path);
+				if (last != ScriptFileIO::LastPending.end() && last->second == request)
+				{
+					ScriptFileIO::LastPending.erase(last);
+				}
+			}
+
+			ScriptFileIO::Process(request.get());
+			request->done = true;
+		}
+	}
+
+	void ScriptFileIO::NotifyCompleted()
+	{
+		for (auto i = ScriptFileIO::Requests.begin(); i != ScriptFileIO::Requests.end();)
+		{
+			const auto request = *i;
+
+			if (!request->done)
+			{
+				++i;
+				continue;
+			}
+
+			for (const auto object : request->objects)
+			{
+				if (Game::Scr_IsSystemActive())
+				{
+					Game::Scr_AddString(request->result.data()); // No binary data supported yet
+					Game::Scr_AddInt(request->success);
+					Game::Scr_NotifyId(object, Game::SL_GetString("done", 0), 2);
+				}
+
+				Game::RemoveRefToObject(object);
+			}
+
+			i = ScriptFileIO::Requests.erase(i);
+		}
+	}
+
+	void ScriptFileIO::ReleaseObjects()
+	{
+		// Queued operations are still carried out, only the notifications are dropped
+		for (const auto& request : ScriptFileIO::Requests)
+		{
+			for (const auto object : request->objects)
+			{
+				Game::RemoveRefToObject(object);
+			}
+
+			request->objects.clear();
+		}
+
+		ScriptFileIO::Requests.clear();
+	}
+
+	void ScriptFileIO::AddFunctions()
+	{
+		Script::AddFunction("FileWriteAsync", [] // gsc: FileWriteAsync(<filepath>, <string>, <mode>)
+		{
+			const auto* path = Game::Scr_GetString(0);
+			if (!ScriptFileIO::IsPathAllowed("FileWriteAsync", path)) return;
+
+			const auto* text = Game::Scr_GetString(1);
+			const auto* mode = Game::Scr_GetString(2);
+
+			if (text == nullptr || mode == nullptr)
+			{
+				Game::Scr_Error("^1FileWriteAsync: Illegal parameters!\n");
+				return;
+			}
+
+			if (mode != "append"s && mode != "write"s)
+			{
+				Logger::Print("^3FileWriteAsync: mode not defined or was wrong, defaulting to 'write'\n");
+				mode = "write";
+			}
+
+			ScriptFileIO::Submit(mode == "append"s ? Operation::Append : Operation::Write, path, text);
+		});
+
+		Script::AddFunction("FileReadAsync", [] // gsc: FileReadAsync(<filepath>)
+		{
+			const auto* path = Game::Scr_GetString(0);
+			if (!ScriptFileIO::IsPathAllowed("FileReadAsync", path)) return;
+
+			ScriptFileIO::Submit(Operation::Read, path);
+		});
+
+		Script::AddFunction("FileExistsAsync", [] // gsc: FileExistsAsync(<filepath>)
+		{
+			const auto* path = Game::Scr_GetString(0);
+			if (!ScriptFileIO::IsPathAllowed("FileExistsAsync", path)) return;
+
+			ScriptFileIO::Submit(Operation::Exists, path);
+		});
+
+		Script::AddFunction("FileRemoveAsync", [] // gsc: FileRemoveAsync(<filepath>)
+		{
+			const auto* path = Game::Scr_GetString(0);
+			if (!ScriptFileIO::IsPathAllowed("FileRemoveAsync", path)) return;
+
+			ScriptFileIO::Submit(Operation::Remove, path);
+		});
+	}
+
+	ScriptFileIO::ScriptFileIO()
+	{
+		Dvar::OnInit([]
+		{
+			ScriptFileIO::QueueLimit = Dvar::Register<int>("sv_scriptFileQueueLimit", 256, 1, 4096, Game::dvar_flag::DVAR_NONE, "Maximum number of pending asynchronous script file operations");
+		});
+
+		ScriptFileIO::AddFunctions();
+
+		Scheduler::OnFrame(ScriptFileIO::NotifyCompleted);
+		Script::OnVMShutdown(ScriptFileIO::ReleaseObjects);
+
+		if (!Loader::IsPerformingUnitTests())
+		{
+			ScriptFileIO::Terminate = false;
+			ScriptFileIO::WorkerThread = std::thread(ScriptFileIO::Worker);
+		}
+	}
+
+	ScriptFileIO::~ScriptFileIO()
+	{
+		ScriptFileIO::Requests.clear();
+	}
+
+	void ScriptFileIO::preDestroy()
+	{
+		{
+			std::lock_guard<std::mutex> _(ScriptFileIO::Mutex);
+			ScriptFileIO::Terminate = true;
+		}
+
+		ScriptFileIO::Condition.notify_all();
+
+		if (ScriptFileIO::WorkerThread.joinable())
+		{
+			ScriptFileIO::WorkerThread.join();
+		}
+	}
+}
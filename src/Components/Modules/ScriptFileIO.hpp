@@ -0,0 +1,65 @@
+#pragma once
+
+namespace Components
+{
+	class ScriptFileIO : public Component
+	{
+	public:
+		ScriptFileIO();
+		~ScriptFileIO();
+
+		void preDestroy() override;
+
+	private:
+		enum class Operation
+		{
+			Read,
+			Write,
+			Append,
+			Exists,
+			Remove,
+		};
+
+		class Request
+		{
+		public:
+			Request(Operation _operation, const std::string& _path) : operation(_operation), path(_path), success(false), done(false) {}
+
+			Operation operation;
+			std::string path;
+			std::string data;
+			std::string result;
+			bool success;
+			std::atomic<bool> done;
+
+			// Only touched on the main thread
+			std::vector<unsigned int> objects;
+		};
+
+		static Dvar::Var QueueLimit;
+
+		static bool Terminate;
+		static std::thread WorkerThread;
+		static std::mutex Mutex;
+		static std::condition_variable Condition;
+
+		// Shared with the worker, guarded by Mutex
+		static std::deque<std::shared_ptr<Request>> Pending;
+		static std::unordered_map<std::string, std::shared_ptr<Request>> LastPending;
+
+		// Main thread only, every request that still has script objects to notify
+		static std::vector<std::shared_ptr<Request>> Requests;
+
+		static bool IsPathAllowed(const char* function, const char* path);
+		static std::string GetAbsolutePath(const char* path);
+
+		static void Submit(Operation operation, const char* path, const std::string& data = {});
+		static void Process(Request* request);
+		static void Worker();
+
+		static void NotifyCompleted();
+		static void ReleaseObjects();
+
+		static void AddFunctions();
+	};
+}
@@ -4,6 +4,12 @@ namespace Components
 {
 	ServerInfo::Container ServerInfo::PlayerContainer;
 
+	unsigned int ServerInfo::StateEpoch;
+	std::vector<int> ServerInfo::StateFingerprint;
+
+	ServerInfo::ResponseCache ServerInfo::InfoCache;
+	ServerInfo::ResponseCache ServerInfo::StatusCache;
+
 	Game::dvar_t** ServerInfo::CGScoreboardHeight;
 	Game::dvar_t** ServerInfo::CGScoreboardWidth;
 
@@ -174,6 +180,202 @@ namespace Components
 		return info;
 	}
 
+	std::string ServerInfo::BuildInfoTail()
+	{
+		int botCount = 0;
+		int clientCount = 0;
+		int maxclientCount = *Game::svs_clientCount;
+
+		if (maxclientCount)
+		{
+			for (int i = 0; i < maxclientCount; ++i)
+			{
+				if (Game::svs_clients[i].state >= 3)
+				{
+					if (Game::svs_clients[i].bIsTestClient) ++botCount;
+					else ++clientCount;
+				}
+			}
+		}
+		else
+		{
+			maxclientCount = Dvar::Var("party_maxplayers").get<int>();
+			//maxclientCount = Game::Party_GetMaxPlayers(*Game::partyIngame);
+			clientCount = Game::PartyHost_CountMembers(reinterpret_cast<Game::PartyData_s*>(0x1081C00));
+		}
+
+		Utils::InfoString info;
+		info.set("gamename", "IW4");
+		info.set("hostname", Dvar::Var("sv_hostname").get<const char*>());
+		info.set("gametype", Dvar::Var("g_gametype").get<const char*>());
+		info.set("fs_game", Dvar::Var("fs_game").get<const char*>());
+		info.set("xuid", Utils::String::VA("%llX", Steam::SteamUser()->GetSteamID().bits));
+		info.set("clients", Utils::String::VA("%i", clientCount));
+		info.set("bots", Utils::String::VA("%i", botCount));
+		info.set("sv_maxclients", Utils::String::VA("%i", maxclientCount));
+		info.set("protocol", Utils::String::VA("%i", PROTOCOL));
+		info.set("shortversion", SHORTVERSION);
+		info.set("mapname", Dvar::Var("mapname").get<const char*>());
+		info.set("isPrivate", (Dvar::Var("g_password").get<std::string>().size() ? "1" : "0"));
+		info.set("hc", (Dvar::Var("g_hardcore").get<bool>() ? "1" : "0"));
+		info.set("securityLevel", Utils::String::VA("%i", Dvar::Var("sv_securityLevel").get<int>()));
+		info.set("sv_running", (Dvar::Var("sv_running").get<bool>() ? "1" : "0"));
+
+		// Ensure mapname is set
+		if (info.get("mapname").empty() || Party::IsInLobby())
+		{
+			info.set("mapname", Dvar::Var("ui_mapname").get<const char*>());
+		}
+
+		if (Maps::GetUserMap()->isValid())
+		{
+			info.set("usermaphash", Utils::String::VA("%i", Maps::GetUserMap()->getHash()));
+		}
+		else if (Party::IsInUserMapLobby())
+		{
+			info.set("usermaphash", Utils::String::VA("%i", Maps::GetUsermapHash(info.get("mapname"))));
+		}
+
+		if (Dedicated::IsEnabled())
+		{
+			info.set("sv_motd", Dvar::Var("sv_motd").get<std::string>());
+		}
+
+		// Set matchtype
+		// 0 - No match, connecting not possible
+		// 1 - Party, use Steam_JoinLobby to connect
+		// 2 - Match, use CL_ConnectFromParty to connect
+
+		if (Dvar::Var("party_enable").get<bool>() && Dvar::Var("party_host").get<bool>()) // Party hosting
+		{
+			info.set("matchtype", "1");
+		}
+		else if (Dvar::Var("sv_running").get<bool>()) // Match hosting
+		{
+			info.set("matchtype", "2");
+		}
+		else
+		{
+			info.set("matchtype", "0");
+		}
+
+		info.set("wwwDownload", (Dvar::Var("sv_wwwDownload").get<bool>() ? "1" : "0"));
+		info.set("wwwUrl", Dvar::Var("sv_wwwBaseUrl").get<std::string>());
+
+		return "\\" + info.build();
+	}
+
+	std::string ServerInfo::BuildStatusTail()
+	{
+		Utils::InfoString info = ServerInfo::GetInfo();
+		info.remove("checksum");
+
+		return "\\" + info.build();
+	}
+
+	std::string ServerInfo::BuildPlayerList()
+	{
+		std::string playerList;
+
+		int maxclientCount = *Game::svs_clientCount;
+		if (!maxclientCount) maxclientCount = Dvar::Var("party_maxplayers").get<int>();
+
+		for (int i = 0; i < maxclientCount; ++i) // Maybe choose 18 here?
+		{
+			int score = 0;
+			int ping = 0;
+			std::string name;
+
+			if (Dvar::Var("sv_running").get<bool>())
+			{
+				if (Game::svs_clients[i].state < 3) continue;
+
+				score = Game::SV_GameClientNum_Score(i);
+				ping = Game::svs_clients[i].ping;
+				name = Game::svs_clients[i].name;
+			}
+			else
+			{
+				// Score and ping are irrelevant
+				const char* namePtr = Game::PartyHost_GetMemberName(reinterpret_cast<Game::PartyData_t*>(0x1081C00), i);
+				if (!namePtr || !namePtr[0]) continue;
+
+				name = namePtr;
+			}
+
+			playerList.append(Utils::String::VA("%i %i \"%s\"\n", score, ping, name.data()));
+		}
+
+		return playerList;
+	}
+
+	void ServerInfo::CheckState()
+	{
+		// Cheap per-frame fingerprint of what changes the info outside of dvars:
+		// connecting and disconnecting clients and the map itself
+		static std::vector<int> state;
+		state.clear();
+
+		const auto running = Dvar::Var("sv_running").get<bool>();
+		state.push_back(running);
+		state.push_back(*Game::svs_clientCount);
+
+		if (running)
+		{
+			for (int i = 0; i < *Game::svs_clientCount; ++i)
+			{
+				state.push_back(Game::svs_clients[i].state);
+				state.push_back(Game::svs_clients[i].bIsTestClient);
+			}
+		}
+		else
+		{
+			state.push_back(Game::PartyHost_CountMembers(reinterpret_cast<Game::PartyData_s*>(0x1081C00)));
+		}
+
+		state.push_back(static_cast<int>(Utils::Cryptography::JenkinsOneAtATime::Compute(Dvar::Var("mapname").get<const char*>())));
+		state.push_back(static_cast<int>(Utils::Cryptography::JenkinsOneAtATime::Compute(Dvar::Var("ui_mapname").get<const char*>())));
+
+		if (state != ServerInfo::StateFingerprint)
+		{
+			ServerInfo::StateFingerprint = state;
+			++ServerInfo::StateEpoch;
+		}
+	}
+
+	const std::string& ServerInfo::GetCachedTail(ResponseCache* cache, std::string(*builder)())
+	{
+		const auto dvarEpoch = Dvar::GetModificationEpoch();
+		const auto now = Game::Sys_Milliseconds();
+
+		if (!cache->valid || cache->stateEpoch != ServerInfo::StateEpoch || cache->dvarEpoch != dvarEpoch || (now - cache->buildTime) > SERVERINFO_CACHE_MAX_AGE)
+		{
+			cache->tail = builder();
+			cache->stateEpoch = ServerInfo::StateEpoch;
+			cache->dvarEpoch = dvarEpoch;
+			cache->buildTime = now;
+			cache->valid = true;
+		}
+
+		return cache->tail;
+	}
+
+	std::string ServerInfo::GetInfoResponse(const std::string& challenge)
+	{
+		// Keys are not required to be sorted, so the challenge simply goes first
+		const auto& tail = ServerInfo::GetCachedTail(&ServerInfo::InfoCache, ServerInfo::BuildInfoTail);
+		return "\\challenge\\" + challenge.substr(0, challenge.find('\\')) + tail + Utils::String::VA("\\checksum\\%d", Game::Sys_Milliseconds());
+	}
+
+	std::string ServerInfo::GetStatusResponse(const std::string& challenge)
+	{
+		// Scores and pings change all the time, only the info part is cached
+		const auto& tail = ServerInfo::GetCachedTail(&ServerInfo::StatusCache, ServerInfo::BuildStatusTail);
+		const auto checksum = Utils::Cryptography::JenkinsOneAtATime::Compute(Utils::String::VA("%u", Game::Sys_Milliseconds()));
+
+		return "\\challenge\\" + challenge.substr(0, challenge.find('\\')) + tail + Utils::String::VA("\\checksum\\%X", checksum) + "\n" + ServerInfo::BuildPlayerList() + "\n";
+	}
+
 	ServerInfo::ServerInfo()
 	{
 		ServerInfo::PlayerContainer.currentPlayer = 0;
@@ -184,6 +386,8 @@ namespace Components
 		// Draw IP and hostname on the scoreboard
 		Utils::Hook(0x4FC6EA, ServerInfo::DrawScoreboardStub, HOOK_CALL).install()->quick();
 
+		Scheduler::OnFrame(ServerInfo::CheckState);
+
 		// Ignore native getStatus implementation
 		Utils::Hook::Nop(0x62654E, 6);
 
@@ -195,38 +399,7 @@ namespace Components
 
 		Network::Handle("getStatus", [](Network::Address address, const std::string& data)
 		{
-			std::string playerList;
-
-			Utils::InfoString info = ServerInfo::GetInfo();
-			info.set("challenge", Utils::ParseChallenge(data));
-
-			for (int i = 0; i < atoi(info.get("sv_maxclients").data()); ++i) // Maybe choose 18 here?
-			{
-				int score = 0;
-				int ping = 0;
-				std::string name;
-
-				if (Dvar::Var("sv_running").get<bool>())
-				{
-					if (Game::svs_clients[i].state < 3) continue;
-
-					score = Game::SV_GameClientNum_Score(i);
-					ping = Game::svs_clients[i].ping;
-					name = Game::svs_clients[i].name;
-				}
-				else
-				{
-					// Score and ping are irrelevant
-					const char* namePtr = Game::PartyHost_GetMemberName(reinterpret_cast<Game::PartyData_t*>(0x1081C00), i);
-					if (!namePtr || !namePtr[0]) continue;
-
-					name = namePtr;
-				}
-
-				playerList.append(Utils::String::VA("%i %i \"%s\"\n", score, ping, name.data()));
-			}
-
-			Network::SendCommand(address, "statusResponse", "\\" + info.build() + "\n" + playerList + "\n");
+			Network::SendCommand(address, "statusResponse", ServerInfo::GetStatusResponse(Utils::ParseChallenge(data)));
 		});
 
 		Network::Handle("statusResponse", [](Network::Address address, const std::string& data)
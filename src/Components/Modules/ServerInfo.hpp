@@ -1,5 +1,7 @@
 #pragma once
 
+#define SERVERINFO_CACHE_MAX_AGE 1000
+
 namespace Components
 {
 	class ServerInfo : public Component
@@ -11,6 +13,10 @@ namespace Components
 		static Utils::InfoString GetHostInfo();
 		static Utils::InfoString GetInfo();
 
+		// Prebuilt infoResponse/statusResponse payloads with the challenge spliced in
+		static std::string GetInfoResponse(const std::string& challenge);
+		static std::string GetStatusResponse(const std::string& challenge);
+
 	private:
 		class Container
 		{
@@ -28,6 +34,28 @@ namespace Components
 			Network::Address target;
 		};
 
+		class ResponseCache
+		{
+		public:
+			ResponseCache() : stateEpoch(0), dvarEpoch(0), buildTime(0), valid(false) {}
+
+			unsigned int stateEpoch;
+			unsigned int dvarEpoch;
+			int buildTime;
+			bool valid;
+
+			// Info keys following the challenge, without the checksum
+			std::string tail;
+		};
+
+		// Bumped when clients or the map change, dvar changes are tracked by Dvar::GetModificationEpoch.
+		// The engine also sets dvars directly, so caches still expire after SERVERINFO_CACHE_MAX_AGE ms.
+		static unsigned int StateEpoch;
+		static std::vector<int> StateFingerprint;
+
+		static ResponseCache InfoCache;
+		static ResponseCache StatusCache;
+
 		static Game::dvar_t** CGScoreboardHeight;
 		static Game::dvar_t** CGScoreboardWidth;
 
@@ -35,6 +63,12 @@ namespace Components
 
 		static void ServerStatus(UIScript::Token);
 
+		static void CheckState();
+		static const std::string& GetCachedTail(ResponseCache* cache, std::string(*builder)());
+		static std::string BuildInfoTail();
+		static std::string BuildStatusTail();
+		static std::string BuildPlayerList();
+
 		static unsigned int GetPlayerCount();
 		static const char* GetPlayerText(unsigned int index, int column);
 		static void SelectPlayer(unsigned int index);
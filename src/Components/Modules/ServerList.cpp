@@ -8,20 +8,104 @@ namespace Components
 	unsigned int ServerList::CurrentServer = 0;
 	ServerList::Container ServerList::RefreshContainer;
 
-	std::vector<ServerList::ServerInfo> ServerList::OnlineList;
-	std::vector<ServerList::ServerInfo> ServerList::OfflineList;
-	std::vector<ServerList::ServerInfo> ServerList::FavouriteList;
+	ServerList::ServerTable ServerList::OnlineList;
+	ServerList::ServerTable ServerList::OfflineList;
+	ServerList::ServerTable ServerList::FavouriteList;
+
+	bool ServerList::SnapshotPending = false;
 
 	std::vector<unsigned int> ServerList::VisibleList;
+	ServerList::Filter ServerList::VisibleFilter;
 
 	Dvar::Var ServerList::UIServerSelected;
 	Dvar::Var ServerList::UIServerSelectedMap;
 	Dvar::Var ServerList::NETServerQueryLimit;
+	Dvar::Var ServerList::NETServerQueryWindow;
 	Dvar::Var ServerList::NETServerFrames;
 
 	bool ServerList::useMasterServer = true;
 
-	std::vector<ServerList::ServerInfo>* ServerList::GetList()
+	unsigned int ServerList::ServerTable::insert(const ServerInfo& server)
+	{
+		auto existing = this->index.find(server.addr);
+		if (existing != this->index.end())
+		{
+			this->slots[existing->second] = server;
+			return existing->second;
+		}
+
+		unsigned int slot;
+		if (!this->freeSlots.empty())
+		{
+			slot = this->freeSlots.back();
+			this->freeSlots.pop_back();
+
+			this->slots[slot] = server;
+			this->used[slot] = true;
+		}
+		else
+		{
+			slot = this->slots.size();
+
+			this->slots.push_back(server);
+			this->used.push_back(true);
+		}
+
+		this->index[server.addr] = slot;
+		++this->count;
+
+		return slot;
+	}
+
+	bool ServerList::ServerTable::remove(const Network::Address& address)
+	{
+		auto existing = this->index.find(address);
+		if (existing == this->index.end()) return false;
+
+		const auto slot = existing->second;
+		this->index.erase(existing);
+
+		this->slots[slot] = ServerInfo();
+		this->used[slot] = false;
+		this->freeSlots.push_back(slot);
+		--this->count;
+
+		return true;
+	}
+
+	void ServerList::ServerTable::clear()
+	{
+		this->slots.clear();
+		this->used.clear();
+		this->freeSlots.clear();
+		this->index.clear();
+		this->count = 0;
+	}
+
+	ServerList::ServerInfo* ServerList::ServerTable::get(unsigned int slot)
+	{
+		if (slot >= this->slots.size() || !this->used[slot]) return nullptr;
+		return &this->slots[slot];
+	}
+
+	bool ServerList::ServerTable::getSlot(const Network::Address& address, unsigned int* slot)
+	{
+		auto existing = this->index.find(address);
+		if (existing == this->index.end()) return false;
+
+		*slot = existing->second;
+		return true;
+	}
+
+	ServerList::ServerInfo* ServerList::ServerTable::find(const Network::Address& address)
+	{
+		auto existing = this->index.find(address);
+		if (existing == this->index.end()) return nullptr;
+
+		return &this->slots[existing->second];
+	}
+
+	ServerList::ServerTable* ServerList::GetList()
 	{
 		if (ServerList::IsOnlineList())
 		{
@@ -176,24 +260,40 @@ namespace Components
 		auto list = ServerList::GetList();
 		if (!list) return;
 
-		std::vector<ServerList::ServerInfo> tempList(*list);
+		// Show the restored servers right away and update them in the background
+		if (list == &ServerList::OnlineList && ServerList::SnapshotPending)
+		{
+			ServerList::SnapshotPending = false;
+			ServerList::Revalidate();
+			return;
+		}
 
-		if (tempList.empty())
+		if (list->empty())
 		{
 			ServerList::Refresh(UIScript::Token());
 		}
 		else
 		{
+			std::vector<Network::Address> addresses;
+			for (auto& server : *list)
+			{
+				addresses.push_back(server.addr);
+			}
+
 			list->clear();
 
+			ServerList::VisibleList.clear();
+			ServerList::LoadFilter();
+
 			std::lock_guard<std::recursive_mutex> _(ServerList::RefreshContainer.mutex);
 
 			ServerList::RefreshContainer.sendCount = 0;
 			ServerList::RefreshContainer.sentCount = 0;
+			ServerList::ResetQueries();
 
-			for (auto& server : tempList)
+			for (auto& address : addresses)
 			{
-				ServerList::InsertRequest(server.addr);
+				ServerList::InsertRequest(address);
 			}
 		}
 	}
@@ -218,44 +318,81 @@ namespace Components
 			return;
 		}
 
-		bool ui_browserShowFull     = Dvar::Var("ui_browserShowFull").get<bool>();
-		bool ui_browserShowEmpty    = Dvar::Var("ui_browserShowEmpty").get<bool>();
-		int ui_browserShowHardcore  = Dvar::Var("ui_browserKillcam").get<int>();
-		int ui_browserShowPassword  = Dvar::Var("ui_browserShowPassword").get<int>();
-		int ui_browserMod           = Dvar::Var("ui_browserMod").get<int>();
-		int ui_joinGametype         = Dvar::Var("ui_joinGametype").get<int>();
+		ServerList::LoadFilter();
 
-		for (unsigned int i = 0; i < list->size(); ++i)
+		for (auto i = list->begin(); i != list->end(); ++i)
 		{
-			ServerList::ServerInfo* info = &(*list)[i];
+			if (ServerList::IsVisible(&*i))
+			{
+				ServerList::VisibleList.push_back(i.getSlot());
+			}
+		}
+
+		ServerList::SortList();
+	}
+
+	void ServerList::LoadFilter()
+	{
+		ServerList::VisibleFilter.showFull = Dvar::Var("ui_browserShowFull").get<bool>();
+		ServerList::VisibleFilter.showEmpty = Dvar::Var("ui_browserShowEmpty").get<bool>();
+		ServerList::VisibleFilter.showHardcore = Dvar::Var("ui_browserKillcam").get<int>();
+		ServerList::VisibleFilter.showPassword = Dvar::Var("ui_browserShowPassword").get<int>();
+		ServerList::VisibleFilter.mod = Dvar::Var("ui_browserMod").get<int>();
+		ServerList::VisibleFilter.gametype = Dvar::Var("ui_joinGametype").get<int>();
+	}
 
-			// Filter full servers
-			if (!ui_browserShowFull && info->clients >= info->maxClients) continue;
+	bool ServerList::IsVisible(ServerInfo* info)
+	{
+		const auto& filter = ServerList::VisibleFilter;
+
+		// Filter full servers
+		if (!filter.showFull && info->clients >= info->maxClients) return false;
+
+		// Filter empty servers
+		if (!filter.showEmpty && info->clients <= 0) return false;
 
-			// Filter empty servers
-			if (!ui_browserShowEmpty && info->clients <= 0) continue;
+		// Filter hardcore servers
+		if ((filter.showHardcore == 0 && info->hardcore) || (filter.showHardcore == 1 && !info->hardcore)) return false;
 
-			// Filter hardcore servers
-			if ((ui_browserShowHardcore == 0 && info->hardcore) || (ui_browserShowHardcore == 1 && !info->hardcore)) continue;
+		// Filter servers with password
+		if ((filter.showPassword == 0 && info->password) || (filter.showPassword == 1 && !info->password)) return false;
 
-			// Filter servers with password
-			if ((ui_browserShowPassword == 0 && info->password) || (ui_browserShowPassword == 1 && !info->password)) continue;
+		// Don't show modded servers
+		if ((filter.mod == 0 && info->mod.size()) || (filter.mod == 1 && !info->mod.size())) return false;
 
-			// Don't show modded servers
-			if ((ui_browserMod == 0 && info->mod.size()) || (ui_browserMod == 1 && !info->mod.size())) continue;
+		// Filter by gametype
+		if (filter.gametype > 0 && (filter.gametype - 1) < *Game::gameTypeCount && Game::gameTypes[(filter.gametype - 1)].gameType != info->gametype) return false;
 
-			// Filter by gametype
-			if (ui_joinGametype > 0 && (ui_joinGametype - 1) < *Game::gameTypeCount  && Game::gameTypes[(ui_joinGametype - 1)].gameType != info->gametype) continue;
+		return true;
+	}
 
-			ServerList::VisibleList.push_back(i);
+	void ServerList::UpdateVisibleServer(ServerTable* list, unsigned int slot)
+	{
+		Dvar::Var("ui_serverSelected").set(false);
+
+		auto entry = std::find(ServerList::VisibleList.begin(), ServerList::VisibleList.end(), slot);
+		if (entry != ServerList::VisibleList.end())
+		{
+			ServerList::VisibleList.erase(entry);
 		}
 
-		ServerList::SortList();
+		auto* info = list->get(slot);
+		if (!info || !ServerList::IsVisible(info)) return;
+
+		// Binary insertion behind equal servers, so the order matches a stable sort
+		auto position = std::upper_bound(ServerList::VisibleList.begin(), ServerList::VisibleList.end(), slot, [list](unsigned int server1, unsigned int server2)
+		{
+			return ServerList::CompareServers(list->get(server1), list->get(server2));
+		});
+
+		ServerList::VisibleList.insert(position, slot);
 	}
 
 	void ServerList::Refresh(UIScript::Token)
 	{
 		Dvar::Var("ui_serverSelected").set(false);
+		if (ServerList::IsOnlineList()) ServerList::SnapshotPending = false;
+
 		//Localization::Set("MPUI_SERVERQUERIED", "Sent requests: 0/0");
 
 // 		ServerList::OnlineList.clear();
@@ -266,12 +403,15 @@ namespace Components
 		if (list) list->clear();
 
 		ServerList::VisibleList.clear();
+		ServerList::LoadFilter();
 
 		{
 			std::lock_guard<std::recursive_mutex> _(ServerList::RefreshContainer.mutex);
 			ServerList::RefreshContainer.servers.clear();
+			ServerList::RefreshContainer.sendQueue.clear();
 			ServerList::RefreshContainer.sendCount = 0;
 			ServerList::RefreshContainer.sentCount = 0;
+			ServerList::ResetQueries();
 		}
 
 		if (ServerList::IsOfflineList())
@@ -297,6 +437,7 @@ namespace Components
 			useMasterServer = true;
 
 			ServerList::RefreshContainer.awatingList = true;
+			ServerList::RefreshContainer.revalidating = false;
 			ServerList::RefreshContainer.awaitTime = Game::Sys_Milliseconds();
 			ServerList::RefreshContainer.host = Network::Address(Utils::String::VA("%s:%u", masterServerName, masterPort));
 
@@ -309,6 +450,163 @@ namespace Components
 		}
 	}
 
+	void ServerList::LoadSnapshot()
+	{
+		std::string data;
+		if (!Utils::IO::ReadFile(SERVERLIST_SNAPSHOT_FILE, &data)) return;
+
+		Utils::Memory::Allocator allocator;
+		Utils::Stream::Reader reader(&allocator, data);
+
+		try
+		{
+			std::string magic(reinterpret_cast<char*>(reader.read(sizeof(SERVERLIST_SNAPSHOT_MAGIC) - 1)), sizeof(SERVERLIST_SNAPSHOT_MAGIC) - 1);
+			if (magic != SERVERLIST_SNAPSHOT_MAGIC || reader.read<uint32_t>() != SERVERLIST_SNAPSHOT_VERSION) return;
+
+			const auto count = reader.read<uint32_t>();
+
+			ServerList::OnlineList.clear();
+
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				const auto entry = reader.read<SnapshotEntry>();
+
+				ServerInfo server;
+				server.addr.setType(Game::NA_IP);
+				server.addr.setIP(entry.ip);
+				server.addr.setPort(entry.port);
+				server.ping = entry.ping;
+				server.clients = entry.clients;
+				server.bots = entry.bots;
+				server.maxClients = entry.maxClients;
+				server.matchType = entry.matchType;
+				server.securityLevel = entry.securityLevel;
+				server.password = (entry.flags & SNAPSHOT_PASSWORD) != 0;
+				server.hardcore = (entry.flags & SNAPSHOT_HARDCORE) != 0;
+				server.svRunning = (entry.flags & SNAPSHOT_RUNNING) != 0;
+				server.hostname = reader.readString();
+				server.mapname = reader.readString();
+				server.gametype = reader.readString();
+				server.mod = reader.readString();
+				server.shortversion = reader.readString();
+
+				// Sort keys are computed on revalidation, once the localized texts are available
+				ServerList::OnlineList.insert(server);
+			}
+		}
+		catch (const std::exception&)
+		{
+			// Truncated snapshot, keep what we have
+		}
+
+		ServerList::SnapshotPending = !ServerList::OnlineList.empty();
+		Logger::Print("Restored %u servers from the server list snapshot\n", ServerList::OnlineList.size());
+	}
+
+	void ServerList::StoreSnapshot()
+	{
+		if (ServerList::OnlineList.empty()) return;
+
+		std::string data;
+		data.reserve(ServerList::OnlineList.size() * (sizeof(SnapshotEntry) + 64));
+
+		const uint32_t version = SERVERLIST_SNAPSHOT_VERSION;
+		const auto count = static_cast<uint32_t>(ServerList::OnlineList.size());
+
+		data.append(SERVERLIST_SNAPSHOT_MAGIC, sizeof(SERVERLIST_SNAPSHOT_MAGIC) - 1);
+		data.append(reinterpret_cast<const char*>(&version), sizeof(version));
+		data.append(reinterpret_cast<const char*>(&count), sizeof(count));
+
+		for (auto& server : ServerList::OnlineList)
+		{
+			SnapshotEntry entry;
+			entry.ip = server.addr.getIP().full;
+			entry.port = server.addr.getPort();
+			entry.ping = static_cast<uint16_t>(std::clamp(server.ping, 0, 0xFFFF));
+			entry.clients = static_cast<uint8_t>(server.clients);
+			entry.bots = static_cast<uint8_t>(server.bots);
+			entry.maxClients = static_cast<uint8_t>(server.maxClients);
+			entry.matchType = static_cast<uint8_t>(server.matchType);
+			entry.securityLevel = static_cast<uint8_t>(std::clamp(server.securityLevel, 0, 0xFF));
+			entry.flags = (server.password ? SNAPSHOT_PASSWORD : 0) | (server.hardcore ? SNAPSHOT_HARDCORE : 0) | (server.svRunning ? SNAPSHOT_RUNNING : 0);
+
+			data.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+
+			for (auto* text : { &server.hostname, &server.mapname, &server.gametype, &server.mod, &server.shortversion })
+			{
+				data.append(text->data(), strnlen(text->data(), text->size()));
+				data.push_back('\0');
+			}
+		}
+
+		Utils::IO::WriteFile(SERVERLIST_SNAPSHOT_FILE, data);
+	}
+
+	void ServerList::Revalidate()
+	{
+		std::vector<Network::Address> favourites;
+
+		if (Utils::IO::FileExists("players/favourites.json"))
+		{
+			std::string data = Utils::IO::ReadFile("players/favourites.json");
+			json11::Json object = json11::Json::parse(data, data);
+
+			for (auto& server : object.array_items())
+			{
+				if (server.is_string()) favourites.push_back(server.string_value());
+			}
+		}
+
+		std::vector<ServerInfo*> servers;
+		servers.reserve(ServerList::OnlineList.size());
+
+		for (auto& server : ServerList::OnlineList)
+		{
+			ServerList::ComputeSortKeys(&server);
+			servers.push_back(&server);
+		}
+
+		ServerList::RefreshVisibleListInternal(UIScript::Token());
+
+		// Favourites first, then the servers players are most likely to join
+		std::stable_sort(servers.begin(), servers.end(), [](ServerInfo* server1, ServerInfo* server2)
+		{
+			return server1->ping < server2->ping;
+		});
+
+		std::lock_guard<std::recursive_mutex> _(ServerList::RefreshContainer.mutex);
+
+		ServerList::RefreshContainer.sendCount = 0;
+		ServerList::RefreshContainer.sentCount = 0;
+		ServerList::ResetQueries();
+
+		for (auto& address : favourites)
+		{
+			if (ServerList::OnlineList.find(address)) ServerList::InsertRequest(address);
+		}
+
+		for (auto* server : servers)
+		{
+			ServerList::InsertRequest(server->addr);
+		}
+
+		// New servers are picked up from the master, the ones queried above are skipped when its list arrives
+		const auto masterPort = Dvar::Var("masterPort").get<int>();
+		const auto masterServerName = Dvar::Var("masterServerName").get<const char*>();
+
+		Game::netadr_t masterServerAddr;
+		if (!ServerList::GetMasterServer(masterServerName, masterPort, masterServerAddr)) return;
+
+		useMasterServer = true;
+
+		ServerList::RefreshContainer.awatingList = true;
+		ServerList::RefreshContainer.revalidating = true;
+		ServerList::RefreshContainer.awaitTime = Game::Sys_Milliseconds();
+		ServerList::RefreshContainer.host = Network::Address(Utils::String::VA("%s:%u", masterServerName, masterPort));
+
+		Network::SendCommand(ServerList::RefreshContainer.host, "getservers", Utils::String::VA("IW4 %i full empty", PROTOCOL));
+	}
+
 	void ServerList::StoreFavourite(const std::string& server)
 	{
 		//json11::Json::parse()
@@ -415,142 +713,97 @@ namespace Components
 	{
 		std::lock_guard<std::recursive_mutex> _(ServerList::RefreshContainer.mutex);
 
-		ServerList::Container::ServerContainer container;
+		if (ServerList::RefreshContainer.servers.contains(address)) return;
+
+		auto& container = ServerList::RefreshContainer.servers[address];
 		container.sent = false;
+		container.tries = 0;
 		container.target = address;
 
-		bool alreadyInserted = false;
-		for (auto &server : ServerList::RefreshContainer.servers)
-		{
-			if (server.target == container.target)
-			{
-				alreadyInserted = true;
-				break;
-			}
-		}
+		ServerList::RefreshContainer.sendQueue.push_back(address);
 
-		if (!alreadyInserted)
+		auto list = ServerList::GetList();
+		if (list && list->find(address))
 		{
-			ServerList::RefreshContainer.servers.push_back(container);
-
-			auto list = ServerList::GetList();
-			if (list)
-			{
-				for (auto& server : *list)
-				{
-					if (server.addr == container.target)
-					{
-						--ServerList::RefreshContainer.sendCount;
-						--ServerList::RefreshContainer.sentCount;
-						break;
-					}
-				}
-			}
-
-			++ServerList::RefreshContainer.sendCount;
+			--ServerList::RefreshContainer.sendCount;
+			--ServerList::RefreshContainer.sentCount;
 		}
+
+		++ServerList::RefreshContainer.sendCount;
 	}
 
 	void ServerList::Insert(Network::Address address, Utils::InfoString info)
 	{
 		std::lock_guard<std::recursive_mutex> _(ServerList::RefreshContainer.mutex);
 
-		for (auto i = ServerList::RefreshContainer.servers.begin(); i != ServerList::RefreshContainer.servers.end();)
-		{
-			// Our desired server
-			if (i->target == address && i->sent)
-			{
-				// Challenge did not match
-				if (i->challenge != info.get("challenge"))
-				{
-					// Shall we remove the server from the queue?
-					// Better not, it might send a second response with the correct challenge.
-					// This might happen when users refresh twice (or more often) in a short period of time
-					break;
-				}
-
-				ServerInfo server;
-				server.hostname = info.get("hostname");
-				server.mapname = info.get("mapname");
-				server.gametype = info.get("gametype");
-				server.shortversion = info.get("shortversion");
-				server.mod = info.get("fs_game");
-				server.matchType = atoi(info.get("matchtype").data());
-				server.clients = atoi(info.get("clients").data());
-				server.bots = atoi(info.get("bots").data());
-				server.securityLevel = atoi(info.get("securityLevel").data());
-				server.maxClients = atoi(info.get("sv_maxclients").data());
-				server.password = (atoi(info.get("isPrivate").data()) != 0);
-				server.hardcore = (atoi(info.get("hc").data()) != 0);
-				server.svRunning = (atoi(info.get("sv_running").data()) != 0);
-				server.ping = (Game::Sys_Milliseconds() - i->sendTime);
-				server.addr = address;
-
-				server.hostname = TextRenderer::StripMaterialTextIcons(server.hostname);
-				server.mapname = TextRenderer::StripMaterialTextIcons(server.mapname);
-				server.gametype = TextRenderer::StripMaterialTextIcons(server.gametype);
-				server.mod = TextRenderer::StripMaterialTextIcons(server.mod);
-
-				// Remove server from queue
-				i = ServerList::RefreshContainer.servers.erase(i);
-
-				// Servers with more than 18 players or less than 0 players are faking for sure
-				// So lets ignore those
-				if (server.clients > 18 || server.maxClients > 18 || server.clients < 0 || server.maxClients < 0)
-					return;
+		// Our desired server
+		auto request = ServerList::RefreshContainer.servers.find(address);
+		if (request == ServerList::RefreshContainer.servers.end() || !request->second.sent) return;
 
-				// Check if already inserted and remove
-				auto list = ServerList::GetList();
-				if (!list) return;
+		// Challenge did not match
+		if (request->second.challenge != info.get("challenge"))
+		{
+			// Shall we remove the server from the queue?
+			// Better not, it might send a second response with the correct challenge.
+			// This might happen when users refresh twice (or more often) in a short period of time
+			return;
+		}
 
-				unsigned int k = 0;
-				for (auto j = list->begin(); j != list->end(); ++k)
-				{
-					if (j->addr == address)
-					{
-						j = list->erase(j);
-					}
-					else
-					{
-						++j;
-					}
-				}
+		ServerInfo server;
+		server.hostname = info.get("hostname");
+		server.mapname = info.get("mapname");
+		server.gametype = info.get("gametype");
+		server.shortversion = info.get("shortversion");
+		server.mod = info.get("fs_game");
+		server.matchType = atoi(info.get("matchtype").data());
+		server.clients = atoi(info.get("clients").data());
+		server.bots = atoi(info.get("bots").data());
+		server.securityLevel = atoi(info.get("securityLevel").data());
+		server.maxClients = atoi(info.get("sv_maxclients").data());
+		server.password = (atoi(info.get("isPrivate").data()) != 0);
+		server.hardcore = (atoi(info.get("hc").data()) != 0);
+		server.svRunning = (atoi(info.get("sv_running").data()) != 0);
+		server.ping = (Game::Sys_Milliseconds() - request->second.sendTime);
+		server.addr = address;
+
+		// Every retry uses a new challenge, so the sample is never ambiguous
+		ServerList::OnQueryAnswered(server.ping);
+
+		server.hostname = TextRenderer::StripMaterialTextIcons(server.hostname);
+		server.mapname = TextRenderer::StripMaterialTextIcons(server.mapname);
+		server.gametype = TextRenderer::StripMaterialTextIcons(server.gametype);
+		server.mod = TextRenderer::StripMaterialTextIcons(server.mod);
+
+		// Remove server from queue
+		ServerList::RefreshContainer.servers.erase(request);
+
+		// Servers with more than 18 players or less than 0 players are faking for sure
+		// So lets ignore those
+		if (server.clients > 18 || server.maxClients > 18 || server.clients < 0 || server.maxClients < 0)
+			return;
 
-				// Also remove from visible list
-				for (auto j = ServerList::VisibleList.begin(); j != ServerList::VisibleList.end();)
-				{
-					if (*j == k)
-					{
-						j = ServerList::VisibleList.erase(j);
-					}
-					else
-					{
-						++j;
-					}
-				}
+		auto list = ServerList::GetList();
+		if (!list) return;
 
-				if (info.get("gamename") == "IW4"
-					&& server.matchType
+		if (info.get("gamename") == "IW4"
+			&& server.matchType
 #if !defined(DEBUG) && defined(VERSION_FILTER)
-					&& ServerList::CompareVersion(server.shortversion, SHORTVERSION)
+			&& ServerList::CompareVersion(server.shortversion, SHORTVERSION)
 #endif
-					)
-				{
-					auto lList = ServerList::GetList();
+			)
+		{
+			ServerList::ComputeSortKeys(&server);
 
-					if (lList)
-					{
-						lList->push_back(server);
-						ServerList::RefreshVisibleListInternal(UIScript::Token());
-					}
-				}
+			// Known servers are updated in place, so their slot stays the same
+			ServerList::UpdateVisibleServer(list, list->insert(server));
+		}
+		else
+		{
+			unsigned int slot;
+			if (!list->getSlot(address, &slot)) return;
 
-				break;
-			}
-			else
-			{
-				++i;
-			}
+			list->remove(address);
+			ServerList::UpdateVisibleServer(list, slot);
 		}
 	}
 
@@ -579,43 +832,49 @@ namespace Components
 		return ServerList::GetServer(ServerList::CurrentServer);
 	}
 
-	void ServerList::SortList()
+	void ServerList::ComputeSortKeys(ServerInfo* server)
 	{
-		// Only sort when the serverlist is open
-		if (!ServerList::IsServerListOpen()) return;
+		server->sortKeys.resize(Column::Count);
 
-		std::stable_sort(ServerList::VisibleList.begin(), ServerList::VisibleList.end(), [](const unsigned int &server1, const unsigned int &server2) -> bool
+		for (int column = 0; column < Column::Count; ++column)
 		{
-			ServerInfo* info1 = nullptr;
-			ServerInfo* info2 = nullptr;
+			// Numerical columns are compared directly
+			if (column == Column::Ping || column == Column::Players) continue;
 
-			auto list = ServerList::GetList();
-			if (!list) return false;
+			server->sortKeys[column] = Utils::String::ToLower(TextRenderer::StripColors(ServerList::GetServerInfoText(server, column, true)));
+		}
+	}
 
-			if (list->size() > server1) info1 = &(*list)[server1];
-			if (list->size() > server2) info2 = &(*list)[server2];
+	bool ServerList::CompareServers(ServerInfo* server1, ServerInfo* server2)
+	{
+		if (!server1 || !server2) return false;
+		if (!ServerList::SortAsc) std::swap(server1, server2);
 
-			if (!info1) return false;
-			if (!info2) return false;
+		// Numerical comparisons
+		if (ServerList::SortKey == ServerList::Column::Ping)
+		{
+			return server1->ping < server2->ping;
+		}
+		else if (ServerList::SortKey == ServerList::Column::Players)
+		{
+			return server1->clients < server2->clients;
+		}
 
-			// Numerical comparisons
-			if (ServerList::SortKey == ServerList::Column::Ping)
-			{
-				return info1->ping < info2->ping;
-			}
-			else if (ServerList::SortKey == ServerList::Column::Players)
-			{
-				return info1->clients < info2->clients;
-			}
+		if (ServerList::SortKey < 0 || ServerList::SortKey >= Column::Count || server1->sortKeys.size() <= static_cast<size_t>(ServerList::SortKey) || server2->sortKeys.size() <= static_cast<size_t>(ServerList::SortKey)) return false;
 
-			std::string text1 = Utils::String::ToLower(TextRenderer::StripColors(ServerList::GetServerInfoText(info1, ServerList::SortKey, true)));
-			std::string text2 = Utils::String::ToLower(TextRenderer::StripColors(ServerList::GetServerInfoText(info2, ServerList::SortKey, true)));
+		// ASCII-based comparison
+		return server1->sortKeys[ServerList::SortKey] < server2->sortKeys[ServerList::SortKey];
+	}
 
-			// ASCII-based comparison
-			return text1.compare(text2) < 0;
-		});
+	void ServerList::SortList()
+	{
+		auto list = ServerList::GetList();
+		if (!list) return;
 
-		if (!ServerList::SortAsc) std::reverse(ServerList::VisibleList.begin(), ServerList::VisibleList.end());
+		std::stable_sort(ServerList::VisibleList.begin(), ServerList::VisibleList.end(), [list](unsigned int server1, unsigned int server2)
+		{
+			return ServerList::CompareServers(list->get(server1), list->get(server2));
+		});
 	}
 
 	ServerList::ServerInfo* ServerList::GetServer(unsigned int index)
@@ -625,10 +884,7 @@ namespace Components
 			auto list = ServerList::GetList();
 			if (!list) return nullptr;
 
-			if (list->size() > ServerList::VisibleList[index])
-			{
-				return &(*list)[ServerList::VisibleList[index]];
-			}
+			return list->get(ServerList::VisibleList[index]);
 		}
 
 		return nullptr;
@@ -667,28 +923,172 @@ namespace Components
 			}
 		}
 
-		auto requestLimit = ServerList::NETServerQueryLimit.get<int>();
-		for (unsigned int i = 0; i < ServerList::RefreshContainer.servers.size() && requestLimit > 0; ++i)
+		ServerList::UpdateQueries();
+		ServerList::UpdateVisibleInfo();
+	}
+
+	void ServerList::ResetQueries()
+	{
+		auto& container = ServerList::RefreshContainer;
+
+		container.inFlight.clear();
+		container.retries.clear();
+
+		container.window = SERVERLIST_INITIAL_WINDOW;
+		container.threshold = std::numeric_limits<float>::max(); // Slow start until the first loss
+		container.rtt = 0.0f;
+		container.rttVariance = 0.0f;
+		container.lastDecrease = 0;
+		container.expired = 0;
+	}
+
+	int ServerList::GetQueryTimeout()
+	{
+		auto& container = ServerList::RefreshContainer;
+
+		// Until the first response arrives, assume the worst
+		if (container.rtt <= 0.0f) return SERVERLIST_MAX_TIMEOUT / 2;
+
+		const auto timeout = static_cast<int>(container.rtt + 4.0f * container.rttVariance);
+		return std::clamp(timeout, SERVERLIST_MIN_TIMEOUT, SERVERLIST_MAX_TIMEOUT);
+	}
+
+	void ServerList::OnQueryAnswered(int rtt)
+	{
+		auto& container = ServerList::RefreshContainer;
+		const auto sample = static_cast<float>(std::max(rtt, 1));
+
+		if (container.rtt <= 0.0f)
 		{
-			ServerList::Container::ServerContainer* server = &ServerList::RefreshContainer.servers[i];
+			container.rtt = sample;
+			container.rttVariance = sample / 2.0f;
+		}
+		else
+		{
+			container.rttVariance = 0.75f * container.rttVariance + 0.25f * std::abs(container.rtt - sample);
+			container.rtt = 0.875f * container.rtt + 0.125f * sample;
+		}
+
+		// Slow start below the threshold, additive increase above it
+		if (container.window < container.threshold) container.window += 1.0f;
+		else container.window += 1.0f / container.window;
+
+		container.window = std::min(container.window, static_cast<float>(ServerList::NETServerQueryWindow.get<int>()));
+	}
+
+	void ServerList::OnQueryLost()
+	{
+		auto& container = ServerList::RefreshContainer;
+		const auto now = Game::Sys_Milliseconds();
+
+		// Halve the window at most once per round trip, losses of the same burst count as one
+		if (now - container.lastDecrease < std::max(static_cast<int>(container.rtt), SERVERLIST_MIN_TIMEOUT)) return;
+
+		container.threshold = std::max(container.window / 2.0f, static_cast<float>(SERVERLIST_MIN_WINDOW));
+		container.window = container.threshold;
+		container.lastDecrease = now;
+	}
+
+	void ServerList::UpdateQueries()
+	{
+		auto& container = ServerList::RefreshContainer;
+		const auto now = Game::Sys_Milliseconds();
+		const auto timeout = ServerList::GetQueryTimeout();
+
+		// Order doesn't matter in either list, so entries are removed by moving the last one into their place
+		auto removeAt = [](std::vector<Network::Address>& list, size_t index)
+		{
+			list[index] = list.back();
+			list.pop_back();
+		};
+
+		// Answered requests have been removed from the table, unanswered ones are retried with backoff or expire
+		for (size_t i = 0; i < container.inFlight.size();)
+		{
+			const auto address = container.inFlight[i];
+
+			auto request = container.servers.find(address);
+			if (request == container.servers.end() || !request->second.sent)
+			{
+				removeAt(container.inFlight, i);
+				continue;
+			}
+
+			if (now - request->second.sendTime < timeout)
+			{
+				++i;
+				continue;
+			}
+
+			ServerList::OnQueryLost();
+
+			if (request->second.tries >= SERVERLIST_MAX_TRIES)
+			{
+				++container.expired;
+				container.servers.erase(request);
+
+				// Known servers that stopped responding are dropped from the list
+				unsigned int slot;
+				auto list = ServerList::GetList();
+				if (list && list->getSlot(address, &slot))
+				{
+					list->remove(address);
+					ServerList::UpdateVisibleServer(list, slot);
+				}
+			}
+			else
+			{
+				request->second.sent = false;
+				request->second.retryTime = now + (timeout << (request->second.tries - 1));
+				container.retries.push_back(address);
+			}
+
+			removeAt(container.inFlight, i);
+		}
+
+		// Retries that are due go first
+		for (size_t i = 0; i < container.retries.size();)
+		{
+			const auto address = container.retries[i];
+
+			auto request = container.servers.find(address);
+			if (request != container.servers.end() && now < request->second.retryTime)
+			{
+				++i;
+				continue;
+			}
+
+			if (request != container.servers.end()) container.sendQueue.push_front(address);
+			removeAt(container.retries, i);
+		}
+
+		while (!container.sendQueue.empty() && container.inFlight.size() < static_cast<size_t>(container.window))
+		{
+			auto request = container.servers.find(container.sendQueue.front());
+			container.sendQueue.pop_front();
+
+			if (request == container.servers.end()) continue;
+
+			ServerList::Container::ServerContainer* server = &request->second;
 			if (server->sent) continue;
 
 			// Found server we can send a request to
 			server->sent = true;
-			requestLimit--;
-
-			server->sendTime = Game::Sys_Milliseconds();
+			server->sendTime = now;
 			server->challenge = Utils::Cryptography::Rand::GenerateChallenge();
 
-			++ServerList::RefreshContainer.sentCount;
+			if (!server->tries++) ++container.sentCount;
 
+			container.inFlight.push_back(server->target);
 			Network::SendCommand(server->target, "getinfo", server->challenge);
-
-			// Display in the menu, like in COD4
-			//Localization::Set("MPUI_SERVERQUERIED", Utils::String::VA("Sent requests: %d/%d", ServerList::RefreshContainer.sentCount, ServerList::RefreshContainer.sendCount));
 		}
 
-		ServerList::UpdateVisibleInfo();
+		// Keep the snapshot in sync with the last completed refresh
+		static bool wasActive = false;
+		const auto active = !container.sendQueue.empty() || !container.inFlight.empty() || !container.retries.empty();
+
+		if (wasActive && !active && ServerList::IsOnlineList()) ServerList::StoreSnapshot();
+		wasActive = active;
 	}
 
 	void ServerList::UpdateSource()
@@ -728,6 +1128,8 @@ namespace Components
 		static int servers = 0;
 		static int players = 0;
 		static int bots = 0;
+		static int remaining = 0;
+		static int eta = 0;
 
 		auto list = ServerList::GetList();
 
@@ -737,19 +1139,39 @@ namespace Components
 			int newPlayers = 0;
 			int newBots = 0;
 
-			for (unsigned int i = 0; i < list->size(); ++i)
+			for (auto& server : *list)
 			{
-				newPlayers += list->at(i).clients;
-				newBots += list->at(i).bots;
+				newPlayers += server.clients;
+				newBots += server.bots;
 			}
 
-			if (newSevers != servers || newPlayers != players || newBots != bots)
+			// Estimate the remaining time from the current window and round trip time
+			auto& container = ServerList::RefreshContainer;
+			int newRemaining = container.sendQueue.size() + container.retries.size() + container.inFlight.size();
+			int newEta = 0;
+
+			if (newRemaining && container.rtt > 0.0f)
+			{
+				const auto rate = container.window * 1000.0f / container.rtt;
+				newEta = static_cast<int>(std::ceil(newRemaining / std::max(rate, 1.0f)));
+			}
+
+			if (newSevers != servers || newPlayers != players || newBots != bots || newRemaining != remaining || newEta != eta)
 			{
 				servers = newSevers;
 				players = newPlayers;
 				bots = newBots;
+				remaining = newRemaining;
+				eta = newEta;
 
-				Localization::Set("MPUI_SERVERQUERIED", Utils::String::VA("Servers: %i\nPlayers: %i (%i)", servers, players, bots));
+				if (remaining)
+				{
+					Localization::Set("MPUI_SERVERQUERIED", Utils::String::VA("Servers: %i (%i left, ~%is)\nPlayers: %i (%i)", servers, remaining, eta, players, bots));
+				}
+				else
+				{
+					Localization::Set("MPUI_SERVERQUERIED", Utils::String::VA("Servers: %i\nPlayers: %i (%i)", servers, players, bots));
+				}
 			}
 		}
 	}
@@ -784,6 +1206,8 @@ namespace Components
 
 			ServerList::NETServerQueryLimit = Dvar::Register<int>("net_serverQueryLimit", 1,
 				1, 10, Dedicated::IsEnabled() ? Game::dvar_flag::DVAR_NONE : Game::dvar_flag::DVAR_ARCHIVE, "Amount of server queries per frame");
+			ServerList::NETServerQueryWindow = Dvar::Register<int>("net_serverQueryWindow", 256,
+				SERVERLIST_MIN_WINDOW, 1024, Dedicated::IsEnabled() ? Game::dvar_flag::DVAR_NONE : Game::dvar_flag::DVAR_ARCHIVE, "Maximum amount of unanswered server queries");
 			ServerList::NETServerFrames = Dvar::Register<int>("net_serverFrames", 30,
 				1, 60, Dedicated::IsEnabled() ? Game::dvar_flag::DVAR_NONE : Game::dvar_flag::DVAR_ARCHIVE, "Amount of server query frames per second");
 		});
@@ -795,6 +1219,11 @@ namespace Components
 		//Localization::Set("MPUI_SERVERQUERIED", "Sent requests: 0/0");
 		Localization::Set("MPUI_SERVERQUERIED", "Servers: 0\nPlayers: 0 (0)");
 
+		if (!Dedicated::IsEnabled() && !ZoneBuilder::IsEnabled())
+		{
+			ServerList::LoadSnapshot();
+		}
+
 		Network::Handle("getServersResponse", [](Network::Address address, const std::string& data)
 		{
 			if (ServerList::RefreshContainer.host != address) return; // Only parse from host we sent to
@@ -820,9 +1249,14 @@ namespace Components
 				serverAddr.setPort(ntohs(entry[i].port));
 				serverAddr.setType(Game::NA_IP);
 
+				// InsertRequest only knows pending queries, servers that already answered the revalidation are in the list
+				if (ServerList::RefreshContainer.revalidating && ServerList::OnlineList.find(serverAddr)) continue;
+
 				ServerList::InsertRequest(serverAddr);
 			}
 
+			ServerList::RefreshContainer.revalidating = false;
+
 			Logger::Print("Parsed %d servers from master\n", ServerList::RefreshContainer.servers.size() - count);
 		});
 
@@ -925,10 +1359,21 @@ namespace Components
 		Scheduler::OnFrame(ServerList::Frame);
 	}
 
+	void ServerList::preDestroy()
+	{
+		if (Dedicated::IsEnabled() || ZoneBuilder::IsEnabled()) return;
+
+		std::lock_guard<std::recursive_mutex> _(ServerList::RefreshContainer.mutex);
+		ServerList::StoreSnapshot();
+	}
+
 	ServerList::~ServerList()
 	{
 		std::lock_guard<std::recursive_mutex> _(ServerList::RefreshContainer.mutex);
 		ServerList::RefreshContainer.awatingList = false;
 		ServerList::RefreshContainer.servers.clear();
+		ServerList::RefreshContainer.sendQueue.clear();
+		ServerList::RefreshContainer.inFlight.clear();
+		ServerList::RefreshContainer.retries.clear();
 	}
 }
@@ -3,6 +3,17 @@
 // This enables version filtering
 #define VERSION_FILTER
 
+// Server query scheduling, see ServerList::UpdateQueries
+#define SERVERLIST_MIN_WINDOW 4
+#define SERVERLIST_INITIAL_WINDOW 16
+#define SERVERLIST_MAX_TRIES 3
+#define SERVERLIST_MIN_TIMEOUT 250
+#define SERVERLIST_MAX_TIMEOUT 3000
+
+#define SERVERLIST_SNAPSHOT_FILE "players/serverlist.dat"
+#define SERVERLIST_SNAPSHOT_MAGIC "IW4xSRVL"
+#define SERVERLIST_SNAPSHOT_VERSION 1
+
 namespace Components
 {
 	class ServerList : public Component
@@ -28,11 +39,70 @@ namespace Components
 			int securityLevel;
 			bool hardcore;
 			bool svRunning;
+
+			// Lowercase, colorless column texts, computed once on insertion
+			std::vector<std::string> sortKeys;
+		};
+
+		// Servers keyed by address, slots stay valid until the server is removed
+		class ServerTable
+		{
+		public:
+			class iterator
+			{
+			public:
+				iterator(ServerTable* _table, unsigned int _slot) : table(_table), slot(_slot) { this->skip(); }
+
+				ServerInfo& operator*() const { return this->table->slots[this->slot]; }
+				ServerInfo* operator->() const { return &this->table->slots[this->slot]; }
+
+				iterator& operator++() { ++this->slot; this->skip(); return *this; }
+
+				bool operator==(const iterator& obj) const { return this->slot == obj.slot; }
+				bool operator!=(const iterator& obj) const { return this->slot != obj.slot; }
+
+				unsigned int getSlot() const { return this->slot; }
+
+			private:
+				ServerTable* table;
+				unsigned int slot;
+
+				void skip()
+				{
+					while (this->slot < this->table->slots.size() && !this->table->used[this->slot]) ++this->slot;
+				}
+			};
+
+			ServerTable() : count(0) {}
+
+			iterator begin() { return iterator(this, 0); }
+			iterator end() { return iterator(this, this->slots.size()); }
+
+			size_t size() const { return this->count; }
+			bool empty() const { return this->count == 0; }
+
+			// Updates the server in place if its address is already known
+			unsigned int insert(const ServerInfo& server);
+			bool remove(const Network::Address& address);
+			void clear();
+
+			ServerInfo* get(unsigned int slot);
+			bool getSlot(const Network::Address& address, unsigned int* slot);
+			ServerInfo* find(const Network::Address& address);
+
+		private:
+			std::vector<ServerInfo> slots;
+			std::vector<bool> used;
+			std::vector<unsigned int> freeSlots;
+			AddressMap<unsigned int> index;
+			size_t count;
 		};
 
 		ServerList();
 		~ServerList();
 
+		void preDestroy() override;
+
 		static void Refresh(UIScript::Token);
 		static void RefreshVisibleList(UIScript::Token);
 		static void RefreshVisibleListInternal(UIScript::Token, bool refresh = false);
@@ -47,7 +117,7 @@ namespace Components
 		static bool IsOnlineList();
 
 		static void Frame();
-		static std::vector<ServerInfo>* GetList();
+		static ServerTable* GetList();
 
 		static void UpdateVisibleInfo();
 
@@ -65,6 +135,19 @@ namespace Components
 			Gametype,
 			Mod,
 			Ping,
+
+			Count
+		};
+
+		class Filter
+		{
+		public:
+			bool showFull;
+			bool showEmpty;
+			int showHardcore;
+			int showPassword;
+			int mod;
+			int gametype;
 		};
 
 #pragma pack(push, 1)
@@ -88,8 +171,29 @@ namespace Components
 				return (token[6] == '\\');
 			}
 		};
+
+		// Followed by the null-terminated hostname, mapname, gametype, mod and shortversion
+		struct SnapshotEntry
+		{
+			uint32_t ip;
+			uint16_t port;
+			uint16_t ping;
+			uint8_t clients;
+			uint8_t bots;
+			uint8_t maxClients;
+			uint8_t matchType;
+			uint8_t securityLevel;
+			uint8_t flags;
+		};
 #pragma pack(pop)
 
+		enum SnapshotFlags
+		{
+			SNAPSHOT_PASSWORD = 1,
+			SNAPSHOT_HARDCORE = 2,
+			SNAPSHOT_RUNNING = 4,
+		};
+
 		class Container
 		{
 		public:
@@ -98,19 +202,33 @@ namespace Components
 			public:
 				bool sent;
 				int sendTime;
+				int retryTime;
+				unsigned int tries;
 				std::string challenge;
 				Network::Address target;
 			};
 
 			bool awatingList;
+			bool revalidating; // Awaited list only adds servers missing from the restored snapshot
 			int awaitTime;
 
 			int sentCount;
 			int sendCount;
 
 			Network::Address host;
-			std::vector<ServerContainer> servers;
+			AddressMap<ServerContainer> servers;
+			std::deque<Network::Address> sendQueue; // Unsent requests in insertion order
+			std::vector<Network::Address> inFlight;
+			std::vector<Network::Address> retries;
 			std::recursive_mutex mutex;
+
+			// Congestion window (AIMD) and smoothed round-trip time, all times in milliseconds
+			float window;
+			float threshold;
+			float rtt;
+			float rttVariance;
+			int lastDecrease;
+			unsigned int expired;
 		};
 
 		static unsigned int GetServerCount();
@@ -121,7 +239,22 @@ namespace Components
 		static void UpdateSource();
 		static void UpdateGameType();
 
+		static void ResetQueries();
+		static void UpdateQueries();
+		static void OnQueryAnswered(int rtt);
+		static void OnQueryLost();
+		static int GetQueryTimeout();
+
 		static void SortList();
+		static void ComputeSortKeys(ServerInfo* server);
+		static bool CompareServers(ServerInfo* server1, ServerInfo* server2);
+		static void LoadFilter();
+		static bool IsVisible(ServerInfo* server);
+		static void UpdateVisibleServer(ServerTable* list, unsigned int slot);
+
+		static void LoadSnapshot();
+		static void StoreSnapshot();
+		static void Revalidate();
 
 		static void LoadFavourties();
 		static void StoreFavourite(const std::string& server);
@@ -137,15 +270,21 @@ namespace Components
 		static unsigned int CurrentServer;
 		static Container RefreshContainer;
 
-		static std::vector<ServerInfo> OnlineList;
-		static std::vector<ServerInfo> OfflineList;
-		static std::vector<ServerInfo> FavouriteList;
+		static ServerTable OnlineList;
+		static ServerTable OfflineList;
+		static ServerTable FavouriteList;
+
+		// The online list has been restored from a snapshot and not been revalidated yet
+		static bool SnapshotPending;
 
+		// Slots of the current list, kept sorted
 		static std::vector<unsigned int> VisibleList;
+		static Filter VisibleFilter;
 
 		static Dvar::Var UIServerSelected;
 		static Dvar::Var UIServerSelectedMap;
 		static Dvar::Var NETServerQueryLimit;
+		static Dvar::Var NETServerQueryWindow;
 		static Dvar::Var NETServerFrames;
 
 		static bool IsServerListOpen();
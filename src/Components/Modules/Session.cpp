@@ -6,15 +6,18 @@ namespace Components
 	std::thread Session::Thread;
 
 	std::recursive_mutex Session::Mutex;
-	std::unordered_map<Network::Address, Session::Frame> Session::Sessions;
-	std::unordered_map<Network::Address, std::queue<std::shared_ptr<Session::Packet>>> Session::PacketQueue;
+	AddressMap<Session::Frame> Session::Sessions;
+	AddressMap<std::queue<std::shared_ptr<Session::Packet>>> Session::PacketQueue;
 
 	Utils::Cryptography::ECC::Key Session::SignatureKey;
+	std::string Session::PublicKey;
 
 	std::map<std::string, Utils::Slot<Network::Callback>> Session::PacketHandlers;
 
 	std::queue<std::pair<Network::Address, std::string>> Session::SignatureQueue;
 
+	unsigned long long Session::DroppedPackets;
+
 	void Session::Send(Network::Address target, const std::string& command, const std::string& data)
 	{
 #ifdef DISABLE_SESSION
@@ -103,37 +106,49 @@ namespace Components
 
 	void Session::HandleSignatures()
 	{
-		while (!Session::SignatureQueue.empty())
-		{
-			std::unique_lock<std::recursive_mutex> lock(Session::Mutex);
-			auto signature = Session::SignatureQueue.front();
-			Session::SignatureQueue.pop();
+		std::vector<CryptoPool::SignJob> jobs;
 
-			auto queue = Session::PacketQueue.find(signature.first);
-			if (queue == Session::PacketQueue.end()) continue;
+		{
+			std::lock_guard<std::recursive_mutex> _(Session::Mutex);
 
-			if (!queue->second.empty())
+			while (!Session::SignatureQueue.empty())
 			{
+				auto signature = Session::SignatureQueue.front();
+				Session::SignatureQueue.pop();
+
+				auto queue = Session::PacketQueue.find(signature.first);
+				if (queue == Session::PacketQueue.end() || queue->second.empty()) continue;
+
 				std::shared_ptr<Session::Packet> packet = queue->second.front();
 				queue->second.pop();
-				lock.unlock();
 
-				Proto::Session::Packet dataPacket;
-				dataPacket.set_publickey(Session::SignatureKey.getPublicKey());
-				dataPacket.set_signature(Utils::Cryptography::ECC::SignMessage(Session::SignatureKey, signature.second));
-				dataPacket.set_command(packet->command);
-				dataPacket.set_data(packet->data);
+				// Signed by the crypto pool, the packet is sent from the main thread
+				CryptoPool::SignJob job;
+				job.key = Session::SignatureKey;
+				job.message = signature.second;
+				job.callback = [target = signature.first, packet](const std::string& signatureData)
+				{
+					Proto::Session::Packet dataPacket;
+					dataPacket.set_publickey(Session::PublicKey);
+					dataPacket.set_signature(signatureData);
+					dataPacket.set_command(packet->command);
+					dataPacket.set_data(packet->data);
+
+					Network::SendCommand(target, "sessionFin", dataPacket.SerializeAsString());
+				};
 
-				Network::SendCommand(signature.first, "sessionFin", dataPacket.SerializeAsString());
-				std::this_thread::sleep_for(3ms);
+				jobs.push_back(job);
 			}
 		}
+
+		if (!jobs.empty()) CryptoPool::SignBatch(jobs);
 	}
 
 	Session::Session()
 	{
 #ifndef DISABLE_SESSION
 		Session::SignatureKey = Utils::Cryptography::ECC::GenerateKey(512);
+		Session::PublicKey = Session::SignatureKey.getPublicKey();
 		//Scheduler::OnFrame(Session::RunFrame);
 
 		if (!Loader::IsPerformingUnitTests())
@@ -180,15 +195,30 @@ namespace Components
 			Proto::Session::Packet dataPacket;
 			if (!dataPacket.ParseFromString(data)) return;
 
-			Utils::Cryptography::ECC::Key publicKey;
-			publicKey.set(dataPacket.publickey());
+			const auto queued = CryptoPool::Verify(dataPacket.publickey(), challenge, dataPacket.signature(), [address, command = dataPacket.command(), payload = dataPacket.data()](bool valid)
+			{
+				if (!valid) return;
+
+				std::lock_guard<std::recursive_mutex> _(Session::Mutex);
 
-			if (!Utils::Cryptography::ECC::VerifyMessage(publicKey, challenge, dataPacket.signature())) return;
+				auto handler = Session::PacketHandlers.find(command);
+				if (handler == Session::PacketHandlers.end()) return;
+
+				handler->second(address, payload);
+			});
 
-			auto handler = Session::PacketHandlers.find(dataPacket.command());
-			if (handler == Session::PacketHandlers.end()) return;
+			if (!queued)
+			{
+				++Session::DroppedPackets;
 
-			handler->second(address, dataPacket.data());
+				// Floods fill the queue with thousands of packets, don't log every single one
+				static Utils::Time::Interval interval;
+				if (interval.elapsed(1s))
+				{
+					interval.update();
+					Logger::Print("Verify queue full, dropped session packet from %s (%llu dropped in total)\n", address.getCString(), Session::DroppedPackets);
+				}
+			}
 		});
 #endif
 	}
@@ -41,15 +41,19 @@ namespace Components
 		static bool Terminate;
 		static std::thread Thread;
 		static std::recursive_mutex Mutex;
-		static std::unordered_map<Network::Address, Frame> Sessions;
-		static std::unordered_map<Network::Address, std::queue<std::shared_ptr<Packet>>> PacketQueue;
+		static AddressMap<Frame> Sessions;
+		static AddressMap<std::queue<std::shared_ptr<Packet>>> PacketQueue;
 
 		static Utils::Cryptography::ECC::Key SignatureKey;
+		static std::string PublicKey; // Exported once instead of for every packet
 
 		static std::map<std::string, Utils::Slot<Network::Callback>> PacketHandlers;
 
 		static std::queue<std::pair<Network::Address, std::string>> SignatureQueue;
 
+		// Packets dropped because the verify queue was full, the sender's retries cover them
+		static unsigned long long DroppedPackets;
+
 		static void RunFrame();
 		static void HandleSignatures();
 	};
@@ -45,6 +45,7 @@
 #include <filesystem>
 #include <optional>
 #include <random>
+#include <intrin.h>
 
 #pragma warning(pop)
 
@@ -116,6 +117,8 @@
 #include "Utils/InfoString.hpp"
 #include "Utils/Compression.hpp"
 #include "Utils/Cryptography.hpp"
+#include "Utils/HashCache.hpp"
+#include "Utils/TokenBucket.hpp"
 
 #include "Steam/Steam.hpp"
 
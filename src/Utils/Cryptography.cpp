@@ -10,6 +10,7 @@ namespace Utils
 		{
 			DES3::Initialize();
 			Rand::Initialize();
+			ECC::Initialize();
 		}
 
 #pragma region Rand
@@ -44,13 +45,20 @@ namespace Utils
 
 #pragma region ECC
 
-		ECC::Key ECC::GenerateKey(int bits)
-		{
-			ECC::Key key;
+		int ECC::PRNG;
 
+		void ECC::Initialize()
+		{
+			// Keys are used from several threads, registration isn't thread-safe
 			ltc_mp = ltm_desc;
 			register_prng(&sprng_desc);
-			ecc_make_key(nullptr, find_prng("sprng"), bits / 8, key.getKeyPtr());
+			ECC::PRNG = find_prng("sprng");
+		}
+
+		ECC::Key ECC::GenerateKey(int bits)
+		{
+			ECC::Key key;
+			ecc_make_key(nullptr, ECC::PRNG, bits / 8, key.getKeyPtr());
 
 			return key;
 		}
@@ -62,9 +70,7 @@ namespace Utils
 			uint8_t buffer[512];
 			DWORD length = sizeof(buffer);
 
-			ltc_mp = ltm_desc;
-			register_prng(&sprng_desc);
-			ecc_sign_hash(reinterpret_cast<const uint8_t*>(message.data()), message.size(), buffer, &length, nullptr, find_prng("sprng"), key.getKeyPtr());
+			ecc_sign_hash(reinterpret_cast<const uint8_t*>(message.data()), message.size(), buffer, &length, nullptr, ECC::PRNG, key.getKeyPtr());
 
 			return std::string(reinterpret_cast<char*>(buffer), length);
 		}
@@ -73,8 +79,6 @@ namespace Utils
 		{
 			if (!key.isValid()) return false;
 
-			ltc_mp = ltm_desc;
-
 			int result = 0;
 			return (ecc_verify_hash(reinterpret_cast<const uint8_t*>(signature.data()), signature.size(), reinterpret_cast<const uint8_t*>(message.data()), message.size(), &result, key.getKeyPtr()) == CRYPT_OK && result != 0);
 		}
@@ -224,12 +228,59 @@ namespace Utils
 
 		std::string SHA256::Compute(const uint8_t* data, size_t length, bool hex)
 		{
-			uint8_t buffer[32] = { 0 };
+			SHA256 hash;
+			hash.update(data, length);
+			return hash.finalize(hex);
+		}
 
-			hash_state state;
-			sha256_init(&state);
-			sha256_process(&state, data, length);
-			sha256_done(&state, buffer);
+		std::string SHA256::ComputeFile(const std::string& file, bool hex, size_t* size)
+		{
+			SHA256 hash;
+			if (!hash.updateFile(file, size)) return "";
+
+			return hash.finalize(hex);
+		}
+
+		SHA256::SHA256()
+		{
+			sha256_init(&this->state);
+		}
+
+		void SHA256::update(const std::string& data)
+		{
+			this->update(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+		}
+
+		void SHA256::update(const uint8_t* data, size_t length)
+		{
+			sha256_process(&this->state, data, static_cast<unsigned long>(length));
+		}
+
+		bool SHA256::updateFile(const std::string& file, size_t* size)
+		{
+			if (size) *size = 0;
+
+			std::ifstream stream(file, std::ios::binary);
+			if (!stream.is_open()) return false;
+
+			char buffer[0x10000];
+			while (stream)
+			{
+				stream.read(buffer, sizeof(buffer));
+				if (stream.gcount() > 0)
+				{
+					this->update(reinterpret_cast<uint8_t*>(buffer), static_cast<size_t>(stream.gcount()));
+					if (size) *size += static_cast<size_t>(stream.gcount());
+				}
+			}
+
+			return true;
+		}
+
+		std::string SHA256::finalize(bool hex)
+		{
+			uint8_t buffer[32] = { 0 };
+			sha256_done(&this->state, buffer);
 
 			std::string hash(reinterpret_cast<char*>(buffer), sizeof(buffer));
 			if (!hex) return hash;
@@ -241,6 +292,211 @@ namespace Utils
 
 #pragma region SHA512
 
+		namespace
+		{
+			const uint64_t SHA512Constants[80] =
+			{
+				0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
+				0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
+				0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+				0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+				0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
+				0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+				0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
+				0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+				0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+				0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+				0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
+				0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+				0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
+				0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+				0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+				0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817,
+			};
+
+			const uint64_t SHA512InitialState[8] =
+			{
+				0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+				0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179,
+			};
+
+			uint64_t LoadBigEndian64(const uint8_t* data)
+			{
+				uint64_t value = 0;
+				for (int i = 0; i < 8; ++i) value = (value << 8) | data[i];
+				return value;
+			}
+
+			void StoreBigEndian64(uint8_t* data, uint64_t value)
+			{
+				for (int i = 7; i >= 0; --i, value >>= 8) data[i] = static_cast<uint8_t>(value & 0xFF);
+			}
+
+			// Lane operations for the compression function, one 64-bit word per lane
+			struct ScalarLanes
+			{
+				typedef uint64_t Vector;
+				static constexpr size_t Count = 1;
+
+				static Vector Set(uint64_t value) { return value; }
+				static Vector Add(Vector a, Vector b) { return a + b; }
+				static Vector Xor(Vector a, Vector b) { return a ^ b; }
+				static Vector And(Vector a, Vector b) { return a & b; }
+				static Vector AndNot(Vector a, Vector b) { return ~a & b; }
+				template <int N> static Vector Shr(Vector a) { return a >> N; }
+				template <int N> static Vector Rotr(Vector a) { return (a >> N) | (a << (64 - N)); }
+
+				static Vector Load(const uint64_t* lanes) { return lanes[0]; }
+				static void Store(uint64_t* lanes, Vector value) { lanes[0] = value; }
+			};
+
+			struct SSE2Lanes
+			{
+				typedef __m128i Vector;
+				static constexpr size_t Count = 2;
+
+				static Vector Set(uint64_t value) { return _mm_set1_epi64x(value); }
+				static Vector Add(Vector a, Vector b) { return _mm_add_epi64(a, b); }
+				static Vector Xor(Vector a, Vector b) { return _mm_xor_si128(a, b); }
+				static Vector And(Vector a, Vector b) { return _mm_and_si128(a, b); }
+				static Vector AndNot(Vector a, Vector b) { return _mm_andnot_si128(a, b); }
+				template <int N> static Vector Shr(Vector a) { return _mm_srli_epi64(a, N); }
+				template <int N> static Vector Rotr(Vector a) { return _mm_or_si128(_mm_srli_epi64(a, N), _mm_slli_epi64(a, 64 - N)); }
+
+				static Vector Load(const uint64_t* lanes) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes)); }
+				static void Store(uint64_t* lanes, Vector value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), value); }
+			};
+
+			// Only executed if the CPU supports it, see SHA512::HasAVX2
+			struct AVX2Lanes
+			{
+				typedef __m256i Vector;
+				static constexpr size_t Count = 4;
+
+				static Vector Set(uint64_t value) { return _mm256_set1_epi64x(value); }
+				static Vector Add(Vector a, Vector b) { return _mm256_add_epi64(a, b); }
+				static Vector Xor(Vector a, Vector b) { return _mm256_xor_si256(a, b); }
+				static Vector And(Vector a, Vector b) { return _mm256_and_si256(a, b); }
+				static Vector AndNot(Vector a, Vector b) { return _mm256_andnot_si256(a, b); }
+				template <int N> static Vector Shr(Vector a) { return _mm256_srli_epi64(a, N); }
+				template <int N> static Vector Rotr(Vector a) { return _mm256_or_si256(_mm256_srli_epi64(a, N), _mm256_slli_epi64(a, 64 - N)); }
+
+				static Vector Load(const uint64_t* lanes) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes)); }
+				static void Store(uint64_t* lanes, Vector value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), value); }
+			};
+
+			template <typename Lanes>
+			void SHA512Compress(typename Lanes::Vector state[8], const typename Lanes::Vector block[16])
+			{
+				typedef typename Lanes::Vector Vector;
+
+				Vector w[80];
+				for (int t = 0; t < 16; ++t) w[t] = block[t];
+
+				for (int t = 16; t < 80; ++t)
+				{
+					const auto s0 = Lanes::Xor(Lanes::Xor(Lanes::template Rotr<1>(w[t - 15]), Lanes::template Rotr<8>(w[t - 15])), Lanes::template Shr<7>(w[t - 15]));
+					const auto s1 = Lanes::Xor(Lanes::Xor(Lanes::template Rotr<19>(w[t - 2]), Lanes::template Rotr<61>(w[t - 2])), Lanes::template Shr<6>(w[t - 2]));
+					w[t] = Lanes::Add(Lanes::Add(s1, w[t - 7]), Lanes::Add(s0, w[t - 16]));
+				}
+
+				Vector a = state[0], b = state[1], c = state[2], d = state[3];
+				Vector e = state[4], f = state[5], g = state[6], h = state[7];
+
+				for (int t = 0; t < 80; ++t)
+				{
+					const auto sum1 = Lanes::Xor(Lanes::Xor(Lanes::template Rotr<14>(e), Lanes::template Rotr<18>(e)), Lanes::template Rotr<41>(e));
+					const auto ch = Lanes::Xor(Lanes::And(e, f), Lanes::AndNot(e, g));
+					const auto temp1 = Lanes::Add(Lanes::Add(Lanes::Add(h, sum1), Lanes::Add(ch, Lanes::Set(SHA512Constants[t]))), w[t]);
+
+					const auto sum0 = Lanes::Xor(Lanes::Xor(Lanes::template Rotr<28>(a), Lanes::template Rotr<34>(a)), Lanes::template Rotr<39>(a));
+					const auto maj = Lanes::Xor(Lanes::Xor(Lanes::And(a, b), Lanes::And(a, c)), Lanes::And(b, c));
+					const auto temp2 = Lanes::Add(sum0, maj);
+
+					h = g;
+					g = f;
+					f = e;
+					e = Lanes::Add(d, temp1);
+					d = c;
+					c = b;
+					b = a;
+					a = Lanes::Add(temp1, temp2);
+				}
+
+				state[0] = Lanes::Add(state[0], a);
+				state[1] = Lanes::Add(state[1], b);
+				state[2] = Lanes::Add(state[2], c);
+				state[3] = Lanes::Add(state[3], d);
+				state[4] = Lanes::Add(state[4], e);
+				state[5] = Lanes::Add(state[5], f);
+				state[6] = Lanes::Add(state[6], g);
+				state[7] = Lanes::Add(state[7], h);
+			}
+
+			// Builds the padded final blocks of a message, returns the amount of blocks
+			size_t SHA512FinalBlocks(const SHA512::Midstate& midstate, const uint8_t* suffix, size_t suffixLength, uint8_t blocks[256])
+			{
+				const auto used = midstate.tailLength + suffixLength;
+				const auto count = (used + 17 > 128) ? 2u : 1u;
+
+				std::memset(blocks, 0, count * 128);
+				std::memcpy(blocks, midstate.tail, midstate.tailLength);
+				std::memcpy(blocks + midstate.tailLength, suffix, suffixLength);
+				blocks[used] = 0x80;
+
+				// 128-bit big-endian bit length, messages are never long enough to need the upper half
+				StoreBigEndian64(blocks + count * 128 - 8, (midstate.length + suffixLength) * 8);
+
+				return count;
+			}
+
+			// Hashes Lanes::Count suffixes of the same length
+			template <typename Lanes>
+			void SHA512FinishLanes(const SHA512::Midstate& midstate, const uint8_t* const* suffixes, size_t suffixLength, uint8_t* const* hashes)
+			{
+				typedef typename Lanes::Vector Vector;
+
+				uint8_t blocks[Lanes::Count][256];
+				size_t count = 0;
+
+				for (size_t lane = 0; lane < Lanes::Count; ++lane)
+				{
+					count = SHA512FinalBlocks(midstate, suffixes[lane], suffixLength, blocks[lane]);
+				}
+
+				Vector state[8];
+				for (int i = 0; i < 8; ++i) state[i] = Lanes::Set(midstate.state[i]);
+
+				uint64_t words[Lanes::Count];
+				for (size_t block = 0; block < count; ++block)
+				{
+					// Transpose, so every vector holds the same word of all lanes
+					Vector message[16];
+					for (int i = 0; i < 16; ++i)
+					{
+						for (size_t lane = 0; lane < Lanes::Count; ++lane)
+						{
+							words[lane] = LoadBigEndian64(blocks[lane] + block * 128 + i * 8);
+						}
+
+						message[i] = Lanes::Load(words);
+					}
+
+					SHA512Compress<Lanes>(state, message);
+				}
+
+				for (int i = 0; i < 8; ++i)
+				{
+					Lanes::Store(words, state[i]);
+
+					for (size_t lane = 0; lane < Lanes::Count; ++lane)
+					{
+						StoreBigEndian64(hashes[lane] + i * 8, words[lane]);
+					}
+				}
+			}
+		}
+
 		std::string SHA512::Compute(const std::string& data, bool hex)
 		{
 			return SHA512::Compute(reinterpret_cast<const uint8_t*>(data.data()), data.size(), hex);
@@ -248,12 +504,59 @@ namespace Utils
 
 		std::string SHA512::Compute(const uint8_t* data, size_t length, bool hex)
 		{
-			uint8_t buffer[64] = { 0 };
+			SHA512 hash;
+			hash.update(data, length);
+			return hash.finalize(hex);
+		}
 
-			hash_state state;
-			sha512_init(&state);
-			sha512_process(&state, data, length);
-			sha512_done(&state, buffer);
+		std::string SHA512::ComputeFile(const std::string& file, bool hex, size_t* size)
+		{
+			SHA512 hash;
+			if (!hash.updateFile(file, size)) return "";
+
+			return hash.finalize(hex);
+		}
+
+		SHA512::SHA512()
+		{
+			sha512_init(&this->state);
+		}
+
+		void SHA512::update(const std::string& data)
+		{
+			this->update(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+		}
+
+		void SHA512::update(const uint8_t* data, size_t length)
+		{
+			sha512_process(&this->state, data, static_cast<unsigned long>(length));
+		}
+
+		bool SHA512::updateFile(const std::string& file, size_t* size)
+		{
+			if (size) *size = 0;
+
+			std::ifstream stream(file, std::ios::binary);
+			if (!stream.is_open()) return false;
+
+			char buffer[0x10000];
+			while (stream)
+			{
+				stream.read(buffer, sizeof(buffer));
+				if (stream.gcount() > 0)
+				{
+					this->update(reinterpret_cast<uint8_t*>(buffer), static_cast<size_t>(stream.gcount()));
+					if (size) *size += static_cast<size_t>(stream.gcount());
+				}
+			}
+
+			return true;
+		}
+
+		std::string SHA512::finalize(bool hex)
+		{
+			uint8_t buffer[64] = { 0 };
+			sha512_done(&this->state, buffer);
 
 			std::string hash(reinterpret_cast<char*>(buffer), sizeof(buffer));
 			if (!hex) return hash;
@@ -261,6 +564,123 @@ namespace Utils
 			return Utils::String::DumpHex(hash, "");
 		}
 
+		SHA512::Midstate SHA512::Prefix(const uint8_t* data, size_t length)
+		{
+			Midstate midstate;
+			std::memcpy(midstate.state, SHA512InitialState, sizeof(midstate.state));
+			midstate.length = length;
+
+			for (; length >= 128; data += 128, length -= 128)
+			{
+				uint64_t block[16];
+				for (int i = 0; i < 16; ++i) block[i] = LoadBigEndian64(data + i * 8);
+
+				SHA512Compress<ScalarLanes>(midstate.state, block);
+			}
+
+			std::memcpy(midstate.tail, data, length);
+			midstate.tailLength = length;
+
+			return midstate;
+		}
+
+		void SHA512::Finish(const Midstate& midstate, const uint8_t* suffix, size_t suffixLength, uint8_t* hash)
+		{
+			// Longer suffixes would need more than two final blocks
+			if (midstate.tailLength + suffixLength + 17 > 256)
+			{
+				hash_state state;
+				sha512_init(&state);
+
+				for (int i = 0; i < 8; ++i) state.sha512.state[i] = midstate.state[i];
+				state.sha512.length = (midstate.length - midstate.tailLength) * 8;
+
+				sha512_process(&state, midstate.tail, midstate.tailLength);
+				sha512_process(&state, suffix, suffixLength);
+				sha512_done(&state, hash);
+				return;
+			}
+
+			SHA512FinishLanes<ScalarLanes>(midstate, &suffix, suffixLength, &hash);
+		}
+
+		void SHA512::FinishMulti(const Midstate& midstate, const uint8_t* const* suffixes, size_t suffixLength, uint8_t* const* hashes, size_t count)
+		{
+			static const auto avx2 = SHA512::HasAVX2();
+
+			size_t i = 0;
+			if (midstate.tailLength + suffixLength + 17 <= 256)
+			{
+				if (avx2)
+				{
+					for (; i + AVX2Lanes::Count <= count; i += AVX2Lanes::Count)
+					{
+						SHA512FinishLanes<AVX2Lanes>(midstate, suffixes + i, suffixLength, hashes + i);
+					}
+				}
+
+				for (; i + SSE2Lanes::Count <= count; i += SSE2Lanes::Count)
+				{
+					SHA512FinishLanes<SSE2Lanes>(midstate, suffixes + i, suffixLength, hashes + i);
+				}
+			}
+
+			for (; i < count; ++i)
+			{
+				SHA512::Finish(midstate, suffixes[i], suffixLength, hashes[i]);
+			}
+		}
+
+		unsigned int SHA512::CountLeadingZeroBits(const uint8_t* hash, size_t length)
+		{
+			unsigned int bits = 0;
+
+			for (size_t i = 0; i + 4 <= length; i += 4)
+			{
+				const auto word = static_cast<unsigned long>(hash[i]) << 24 | static_cast<unsigned long>(hash[i + 1]) << 16 | static_cast<unsigned long>(hash[i + 2]) << 8 | hash[i + 3];
+
+				if (!word)
+				{
+					bits += 32;
+					continue;
+				}
+
+				unsigned long index;
+				_BitScanReverse(&index, word);
+				return bits + 31 - index;
+			}
+
+			for (size_t i = length & ~3u; i < length; ++i)
+			{
+				if (hash[i])
+				{
+					unsigned long index;
+					_BitScanReverse(&index, hash[i]);
+					return bits + 7 - index;
+				}
+
+				bits += 8;
+			}
+
+			return bits;
+		}
+
+		bool SHA512::HasAVX2()
+		{
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) return false;
+
+			// The OS has to save the YMM registers
+			__cpuid(info, 1);
+			const auto osxsave = (info[2] & (1 << 27)) != 0;
+			const auto avx = (info[2] & (1 << 28)) != 0;
+			if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+		}
+
 #pragma endregion
 
 #pragma region JenkinsOneAtATime
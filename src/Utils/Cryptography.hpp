@@ -6,43 +6,43 @@ namespace Utils
 	{
 		void Initialize();
 
+		// Big-endian counter with inline storage, the significant bytes are kept at the end of the buffer
 		class Token
 		{
 		public:
-			Token() { this->tokenString.clear(); };
-			Token(const Token& obj) : tokenString(obj.tokenString) { };
-			Token(const std::string& token) : tokenString(token.begin(), token.end()) { };
-			Token(const std::basic_string<uint8_t>& token) : tokenString(token.begin(), token.end()) { };
+			static constexpr size_t Capacity = 32;
 
-			Token& operator++ ()
+			Token() : length(0) { std::memset(this->buffer, 0, sizeof(this->buffer)); };
+			Token(const Token& obj) = default;
+			Token(const std::string& token) : Token(reinterpret_cast<const uint8_t*>(token.data()), token.size()) { };
+			Token(const std::basic_string<uint8_t>& token) : Token(token.data(), token.size()) { };
+
+			// Longer tokens can't be reached by incrementing, only their lowest bytes are kept
+			Token(const uint8_t* token, size_t size) : Token()
 			{
-				if (this->tokenString.empty())
+				if (size > Token::Capacity)
 				{
-					this->tokenString.append(reinterpret_cast<uint8_t*>(const_cast<char *>("\0")), 1);
+					token += size - Token::Capacity;
+					size = Token::Capacity;
 				}
-				else
+
+				std::memcpy(this->buffer + Token::Capacity - size, token, size);
+				this->length = size;
+			}
+
+			Token& operator=(const Token& obj) = default;
+
+			Token& operator++ ()
+			{
+				for (size_t i = Token::Capacity; i > Token::Capacity - this->length; --i)
 				{
-					for (int i = static_cast<int>(this->tokenString.size() - 1); i >= 0; --i)
-					{
-						if (this->tokenString[i] == 0xFF)
-						{
-							this->tokenString[i] = 0;
-
-							if (!i)
-							{
-								// Prepend here, as /dev/urandom says so ;) https://github.com/IW4x/iw4x-client-node/wikis/technical-information#incrementing-the-token
-								this->tokenString = std::basic_string<uint8_t>(reinterpret_cast<uint8_t*>(const_cast<char*>("\0")), 1) + this->tokenString;
-								break;
-							}
-						}
-						else
-						{
-							++this->tokenString[i];
-							break;
-						}
-					}
+					if (++this->buffer[i - 1]) return *this;
 				}
 
+				// All bytes wrapped around to zero, so this only prepends a zero byte
+				// Prepend here, as /dev/urandom says so ;) https://github.com/IW4x/iw4x-client-node/wikis/technical-information#incrementing-the-token
+				if (this->length < Token::Capacity) ++this->length;
+
 				return *this;
 			}
 
@@ -53,9 +53,53 @@ namespace Utils
 				return result;
 			}
 
+			// Same as incrementing count times, including the prepending on overflow
+			Token& operator+= (uint64_t count)
+			{
+				if (count && !this->length)
+				{
+					this->length = 1;
+					--count;
+				}
+
+				while (count)
+				{
+					// Can't overflow in practice, just add with carry
+					if (this->length >= sizeof(uint64_t))
+					{
+						for (auto i = Token::Capacity; i > Token::Capacity - this->length && count; --i)
+						{
+							count += this->buffer[i - 1];
+							this->buffer[i - 1] = static_cast<uint8_t>(count & 0xFF);
+							count >>= 8;
+						}
+
+						break;
+					}
+
+					uint64_t value = 0;
+					for (auto i = Token::Capacity - this->length; i < Token::Capacity; ++i) value = (value << 8) | this->buffer[i];
+
+					const auto capacity = 1ull << (this->length * 8);
+					if (count < capacity - value)
+					{
+						value += count;
+						for (auto i = Token::Capacity; i > Token::Capacity - this->length; --i, value >>= 8) this->buffer[i - 1] = static_cast<uint8_t>(value & 0xFF);
+						break;
+					}
+
+					// Overflowing restarts at zero with one more byte
+					count -= capacity - value;
+					++this->length;
+					std::memset(this->buffer + Token::Capacity - this->length, 0, this->length);
+				}
+
+				return *this;
+			}
+
 			bool operator==(const Token& token) const
 			{
-				return (this->toString() == token.toString());
+				return this->length == token.length && !std::memcmp(this->data(), token.data(), this->length);
 			}
 
 			bool operator!=(const Token& token) const
@@ -63,40 +107,16 @@ namespace Utils
 				return !(*this == token);
 			}
 
+			// Shorter tokens were reached first, equal lengths compare like big-endian numbers
 			bool operator<(const Token& token) const
 			{
-				if (*this == token)
-				{
-					return false;
-				}
-				else if (this->toString().size() < token.toString().size())
-				{
-					return true;
-				}
-				else if (this->toString().size() > token.toString().size())
-				{
-					return false;
-				}
-				else
-				{
-					auto lStr = this->toString();
-					auto rStr = token.toString();
-
-					for (unsigned int i = 0; i < lStr.size(); ++i)
-					{
-						if (lStr[i] < rStr[i])
-						{
-							return true;
-						}
-					}
-				}
-
-				return false;
+				if (this->length != token.length) return this->length < token.length;
+				return std::memcmp(this->data(), token.data(), this->length) < 0;
 			}
 
 			bool operator>(const Token& token) const
 			{
-				return (token < *this && *this != token);
+				return token < *this;
 			}
 
 			bool operator<=(const Token& token) const
@@ -109,28 +129,36 @@ namespace Utils
 				return !(*this < token);
 			}
 
-			std::string toString()
+			// Serialized form, points into the token and is invalidated by modifying it
+			const uint8_t* data() const
 			{
-				return std::string(this->tokenString.begin(), this->tokenString.end());
+				return this->buffer + Token::Capacity - this->length;
+			}
+
+			size_t size() const
+			{
+				return this->length;
 			}
 
 			std::string toString() const
 			{
-				return std::string(this->tokenString.begin(), this->tokenString.end());
+				return std::string(reinterpret_cast<const char*>(this->data()), this->length);
 			}
 
-			std::basic_string<uint8_t> toUnsignedString()
+			std::basic_string<uint8_t> toUnsignedString() const
 			{
-				return this->tokenString;
+				return std::basic_string<uint8_t>(this->data(), this->length);
 			}
 
 			void clear()
 			{
-				this->tokenString.clear();
+				std::memset(this->buffer, 0, sizeof(this->buffer));
+				this->length = 0;
 			}
 
 		private:
-			std::basic_string<uint8_t> tokenString;
+			uint8_t buffer[Capacity];
+			size_t length;
 		};
 
 		class Rand
@@ -242,6 +270,11 @@ namespace Utils
 			static Key GenerateKey(int bits);
 			static std::string SignMessage(Key key, const std::string& message);
 			static bool VerifyMessage(Key key, const std::string& message, const std::string& signature);
+
+			static void Initialize();
+
+		private:
+			static int PRNG;
 		};
 
 		class RSA
@@ -318,15 +351,69 @@ namespace Utils
 		class SHA256
 		{
 		public:
+			SHA256();
+
+			void update(const std::string& data);
+			void update(const uint8_t* data, size_t length);
+
+			// Streams the file through a fixed-size buffer, size receives the amount of bytes hashed
+			bool updateFile(const std::string& file, size_t* size = nullptr);
+
+			std::string finalize(bool hex = false);
+
 			static std::string Compute(const std::string& data, bool hex = false);
 			static std::string Compute(const uint8_t* data, size_t length, bool hex = false);
+
+			// Returns an empty string if the file can't be read
+			static std::string ComputeFile(const std::string& file, bool hex = false, size_t* size = nullptr);
+
+		private:
+			hash_state state;
 		};
 
 		class SHA512
 		{
 		public:
+			// State after absorbing all complete blocks of a fixed prefix
+			class Midstate
+			{
+			public:
+				uint64_t state[8];
+				uint8_t tail[128];
+				size_t tailLength;
+				uint64_t length;
+			};
+
+			// Largest amount of messages hashed by one FinishMulti kernel call
+			static constexpr size_t MaxLanes = 8;
+
+			SHA512();
+
+			void update(const std::string& data);
+			void update(const uint8_t* data, size_t length);
+
+			// Streams the file through a fixed-size buffer, size receives the amount of bytes hashed
+			bool updateFile(const std::string& file, size_t* size = nullptr);
+
+			std::string finalize(bool hex = false);
+
 			static std::string Compute(const std::string& data, bool hex = false);
 			static std::string Compute(const uint8_t* data, size_t length, bool hex = false);
+
+			// Returns an empty string if the file can't be read
+			static std::string ComputeFile(const std::string& file, bool hex = false, size_t* size = nullptr);
+
+			static Midstate Prefix(const uint8_t* data, size_t length);
+			static void Finish(const Midstate& midstate, const uint8_t* suffix, size_t suffixLength, uint8_t* hash);
+
+			// Hashes count suffixes of the same length after the prefix, 2 lanes per SSE2 or 4 per AVX2 register
+			static void FinishMulti(const Midstate& midstate, const uint8_t* const* suffixes, size_t suffixLength, uint8_t* const* hashes, size_t count);
+
+			static unsigned int CountLeadingZeroBits(const uint8_t* hash, size_t length = 64);
+			static bool HasAVX2();
+
+		private:
+			hash_state state;
 		};
 
 		class JenkinsOneAtATime
@@ -0,0 +1,158 @@
+#include <STDInclude.hpp>
+
+namespace Utils
+{
+	HashCache::HashCache(const std::string& _directory) : directory(_directory), dirty(false)
+	{
+		this->load();
+	}
+
+	std::string HashCache::getCacheFile()
+	{
+		return this->directory + "\\hashcache.json";
+	}
+
+	void HashCache::load()
+	{
+		std::string data;
+		if (!Utils::IO::ReadFile(this->getCacheFile(), &data)) return;
+
+		std::string error;
+		json11::Json cacheData = json11::Json::parse(data, error);
+
+		if (!error.empty() || !cacheData.is_object()) return;
+
+		std::lock_guard<std::mutex> _(this->mutex);
+
+		for (auto& file : cacheData.object_items())
+		{
+			auto size = file.second["size"];
+			auto modified = file.second["modified"];
+			auto hash = file.second["hash"];
+
+			if (!size.is_number() || !modified.is_string() || !hash.is_string()) continue;
+
+			Entry entry;
+			entry.size = static_cast<size_t>(size.number_value());
+			entry.modified = strtoull(modified.string_value().data(), nullptr, 10);
+			entry.hash = hash.string_value();
+
+			this->entries[file.first] = entry;
+		}
+	}
+
+	void HashCache::save()
+	{
+		std::map<std::string, json11::Json> cacheData;
+
+		{
+			std::lock_guard<std::mutex> _(this->mutex);
+			if (!this->dirty) return;
+
+			for (auto& entry : this->entries)
+			{
+				std::map<std::string, json11::Json> file;
+				file["size"] = static_cast<double>(entry.second.size);
+				file["modified"] = std::to_string(entry.second.modified);
+				file["hash"] = entry.second.hash;
+
+				cacheData[entry.first] = file;
+			}
+
+			this->dirty = false;
+		}
+
+		// The map hash and the manifest build may save the same cache from different threads.
+		// Each writes its own temp file and swaps it in, so readers never see a partial file.
+		const auto file = this->getCacheFile();
+		const auto temp = file + Utils::String::VA(".%u.tmp", GetCurrentThreadId());
+		if (!Utils::IO::WriteFile(temp, json11::Json(cacheData).dump())) return;
+
+		if (!MoveFileExA(temp.data(), file.data(), MOVEFILE_REPLACE_EXISTING))
+		{
+			Utils::IO::RemoveFile(temp);
+		}
+	}
+
+	bool HashCache::find(const std::string& name, std::string* hash, size_t* size)
+	{
+		size_t fileSize;
+		unsigned long long modified;
+		if (!HashCache::GetFileInfo(this->directory + "\\" + name, &fileSize, &modified)) return false;
+
+		std::lock_guard<std::mutex> _(this->mutex);
+
+		auto entry = this->entries.find(name);
+		if (entry == this->entries.end() || entry->second.size != fileSize || entry->second.modified != modified) return false;
+
+		if (hash) *hash = entry->second.hash;
+		if (size) *size = fileSize;
+		return true;
+	}
+
+	std::string HashCache::get(const std::string& name, size_t* size)
+	{
+		std::string hash;
+		if (this->find(name, &hash, size)) return hash;
+
+		std::string file = this->directory + "\\" + name;
+
+		Entry entry;
+		if (!HashCache::GetFileInfo(file, &entry.size, &entry.modified)) return "";
+
+		entry.hash = Utils::Cryptography::SHA256::ComputeFile(file, true);
+		if (entry.hash.empty()) return "";
+
+		if (size) *size = entry.size;
+
+		std::lock_guard<std::mutex> _(this->mutex);
+		this->entries[name] = entry;
+		this->dirty = true;
+
+		return entry.hash;
+	}
+
+	void HashCache::prepare(const std::vector<std::string>& names)
+	{
+		std::vector<std::string> missing;
+		for (auto& name : names)
+		{
+			if (!this->find(name, nullptr))
+			{
+				missing.push_back(name);
+			}
+		}
+
+		if (missing.empty()) return;
+
+		std::atomic<size_t> next = 0;
+		size_t workerCount = std::min(static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())), missing.size());
+
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < workerCount; ++i)
+		{
+			workers.emplace_back([this, &missing, &next]()
+			{
+				for (size_t index = next++; index < missing.size(); index = next++)
+				{
+					this->get(missing[index]);
+				}
+			});
+		}
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	bool HashCache::GetFileInfo(const std::string& file, size_t* size, unsigned long long* modified)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesExA(file.data(), GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) return false;
+
+		*size = static_cast<size_t>(data.nFileSizeLow);
+		*modified = (static_cast<unsigned long long>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+		return true;
+	}
+}
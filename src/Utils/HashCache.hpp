@@ -0,0 +1,37 @@
+#pragma once
+
+namespace Utils
+{
+	// Persistent SHA256 cache for the files of a single directory, entries are keyed by name, size and modification time
+	class HashCache
+	{
+	public:
+		HashCache(const std::string& directory);
+
+		bool find(const std::string& name, std::string* hash, size_t* size = nullptr);
+		std::string get(const std::string& name, size_t* size = nullptr);
+
+		// Hashes all missing or outdated entries in parallel
+		void prepare(const std::vector<std::string>& names);
+		void save();
+
+		static bool GetFileInfo(const std::string& file, size_t* size, unsigned long long* modified);
+
+	private:
+		class Entry
+		{
+		public:
+			size_t size;
+			unsigned long long modified;
+			std::string hash;
+		};
+
+		std::string directory;
+		std::mutex mutex;
+		std::unordered_map<std::string, Entry> entries;
+		bool dirty;
+
+		std::string getCacheFile();
+		void load();
+	};
+}
@@ -7,6 +7,11 @@ namespace Utils
 		this->keyValuePairs[key] = value;
 	}
 
+	void InfoString::remove(const std::string& key)
+	{
+		this->keyValuePairs.erase(key);
+	}
+
 	std::string InfoString::get(const std::string& key)
 	{
 		const auto value = this->keyValuePairs.find(key);
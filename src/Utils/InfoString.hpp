@@ -9,6 +9,7 @@ namespace Utils
 		InfoString(const std::string& buffer) : InfoString() { this->parse(buffer); };
 
 		void set(const std::string& key, const std::string& value);
+		void remove(const std::string& key);
 		std::string get(const std::string& key);
 		std::string build();
 
@@ -0,0 +1,37 @@
+#pragma once
+
+namespace Utils
+{
+	class TokenBucket
+	{
+	public:
+		TokenBucket() : tokens(0.0), lastRefill(std::chrono::steady_clock::now()) {}
+
+		// Rate is given in tokens per second, the bucket never holds more than burst tokens
+		void refill(double rate, double burst)
+		{
+			auto now = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration<double>(now - this->lastRefill).count();
+			this->lastRefill = now;
+
+			this->tokens = std::min(burst, this->tokens + elapsed * rate);
+		}
+
+		double available() const
+		{
+			return std::max(0.0, this->tokens);
+		}
+
+		bool consume(double amount)
+		{
+			if (this->tokens < amount) return false;
+
+			this->tokens -= amount;
+			return true;
+		}
+
+	private:
+		double tokens;
+		std::chrono::steady_clock::time_point lastRefill;
+	};
+}
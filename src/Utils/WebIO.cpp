@@ -256,10 +256,61 @@ namespace Utils
 		return this;
 	}
 
+	bool WebIO::stream(const std::string& _url, Utils::Slot<void(const char*, size_t)> callback, size_t offset)
+	{
+		this->setURL(_url);
+
+		WebIO::Params headers;
+		if (offset)
+		{
+			headers["Range"] = Utils::String::VA("bytes=%u-", offset);
+		}
+
+		DWORD statusCode = 0;
+		DWORD contentLength = 0;
+		size_t received = 0;
+		size_t skip = offset;
+
+		const auto result = this->execute("GET", "", headers, [&](const char* data, size_t size, DWORD length)
+		{
+			contentLength = length;
+			received += size;
+
+			// Servers that don't support ranges send the whole file, skip what the caller already has
+			if (statusCode != 206 && skip)
+			{
+				size_t skipped = std::min(skip, size);
+				skip -= skipped;
+				data += skipped;
+				size -= skipped;
+			}
+
+			if (size) callback(data, size);
+		}, &statusCode);
+
+		// A connection that dropped in the middle of the body must not count as success
+		return (result && (!contentLength || received >= contentLength));
+	}
+
 	std::string WebIO::execute(const char* command, const std::string& body, WebIO::Params headers, bool* success)
 	{
-		if (success) *success = false;
-		if (!this->openConnection()) return "";
+		std::string returnBuffer;
+
+		bool result = this->execute(command, body, headers, [&returnBuffer](const char* data, size_t size, DWORD contentLength)
+		{
+			if (returnBuffer.empty()) returnBuffer.reserve(contentLength);
+			returnBuffer.append(data, size);
+		});
+
+		if (success) *success = result;
+		if (!result) return "";
+
+		return returnBuffer;
+	}
+
+	bool WebIO::execute(const char* command, const std::string& body, WebIO::Params headers, Utils::Slot<void(const char*, size_t, DWORD)> callback, DWORD* statusCode)
+	{
+		if (!this->openConnection()) return false;
 
 		const char *acceptTypes[] = { "application/x-www-form-urlencoded", nullptr };
 
@@ -276,7 +327,7 @@ namespace Utils
 		if (!this->hFile || this->hFile == INVALID_HANDLE_VALUE)
 		{
 			this->closeConnection();
-			return "";
+			return false;
 		}
 
 		if (headers.find("Content-Type") == headers.end())
@@ -296,27 +347,27 @@ namespace Utils
 
 		if (HttpSendRequestA(this->hFile, finalHeaders.data(), finalHeaders.size(), const_cast<char*>(body.data()), body.size() + 1) == FALSE)
 		{
-			return "";
+			return false;
 		}
 
-		DWORD statusCode = 404;
-		DWORD length = sizeof(statusCode);
-		if (HttpQueryInfo(this->hFile, HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE, &statusCode, &length, nullptr) == FALSE || (statusCode != 200 && statusCode != 201))
+		DWORD status = 404;
+		DWORD length = sizeof(status);
+		if (HttpQueryInfo(this->hFile, HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE, &status, &length, nullptr) == FALSE || (status != 200 && status != 201 && status != 206))
 		{
 			this->closeConnection();
-			return "";
+			return false;
 		}
 
+		if (statusCode) *statusCode = status;
+
 		DWORD contentLength = 0;
-		length = sizeof(statusCode);
+		length = sizeof(contentLength);
 		if (HttpQueryInfo(this->hFile, HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_CONTENT_LENGTH, &contentLength, &length, nullptr) == FALSE)
 		{
 			contentLength = 0;
 		}
 
-		std::string returnBuffer;
-		returnBuffer.reserve(contentLength);
-
+		size_t received = 0;
 		DWORD size = 0;
 		char buffer[0x2001] = { 0 };
 
@@ -325,18 +376,18 @@ namespace Utils
 			if (this->cancel)
 			{
 				this->closeConnection();
-				return "";
+				return false;
 			}
 
-			returnBuffer.append(buffer, size);
-			if (this->progressCallback) this->progressCallback(returnBuffer.size(), contentLength);
 			if (!size) break;
+
+			received += size;
+			callback(buffer, size, contentLength);
+			if (this->progressCallback) this->progressCallback(received, contentLength);
 		}
 
 		this->closeConnection();
-
-		if (success) *success = true;
-		return returnBuffer;
+		return true;
 	}
 
 	bool WebIO::isSecuredConnection()
@@ -38,6 +38,9 @@ namespace Utils
 		std::string get(const std::string& url, bool* success = nullptr);
 		std::string get(bool* success = nullptr);
 
+		// Passes the body to the callback as it arrives, starting at the given offset
+		bool stream(const std::string& url, Utils::Slot<void(const char*, size_t)> callback, size_t offset = 0);
+
 		WebIO* setTimeout(DWORD mseconds);
 
 		// FTP
@@ -103,6 +106,7 @@ namespace Utils
 		bool isSecuredConnection();
 
 		std::string execute(const char* command, const std::string& body, WebIO::Params headers = WebIO::Params(), bool* success = nullptr);
+		bool execute(const char* command, const std::string& body, WebIO::Params headers, Utils::Slot<void(const char*, size_t, DWORD)> callback, DWORD* statusCode = nullptr);
 
 		bool listElements(const std::string& directory, std::vector<std::string>& list, bool files);
 